@@ -6,28 +6,78 @@
 #ifndef DHT2X_H_
 #define DHT2X_H_
 
+#include <stdbool.h>
 #include <stdint.h>
-#include <zephyr/drivers/gpio.h>
+#include <zephyr/device.h>
+
+/* Falling edges of complete frame: response start, first bit start and end
+ * of every of 40 data bits */
+#define DHT2X_FRAME_BITS (40)
+#define DHT2X_EDGES_MAX  (DHT2X_FRAME_BITS + 2)
+
+/* Histogram bin i counts values in [MIN + i * STEP, MIN + (i + 1) * STEP),
+ * the first bin counts also values below, the last one values above */
+#define DHT2X_LATENCY_HIST_BINS     (8)
+#define DHT2X_LATENCY_HIST_MIN_MS   (18)
+#define DHT2X_LATENCY_HIST_STEP_MS  (2)
+#define DHT2X_PULSE_HIST_BINS       (16)
+#define DHT2X_PULSE_HIST_MIN_US     (40)
+#define DHT2X_PULSE_HIST_STEP_US    (10)
+#define DHT2X_TIMEOUT_HIST_BINS     (8)
+#define DHT2X_TIMEOUT_HIST_STEP_CNT (6)
+
+struct dht2x_stats {
+    uint32_t reads;
+    uint32_t timeouts;        /* frame not complete in time */
+    uint32_t checksum_errors; /* frame complete, checksum mismatch */
+    uint32_t recovered;       /* missed first edge, frame decoded */
+    uint32_t latency_max_us;  /* start signal to decoded frame */
+    uint32_t threshold_us;    /* bit threshold used by the last read */
+    uint32_t latency_hist[DHT2X_LATENCY_HIST_BINS];
+    uint32_t pulse_hist[DHT2X_PULSE_HIST_BINS];     /* edge periods */
+    uint32_t timeout_hist[DHT2X_TIMEOUT_HIST_BINS]; /* edges at timeout */
+};
+
+struct dht2x_frame_info {
+    uint32_t threshold_us; /* bit 0 / bit 1 period threshold */
+    bool recovered;        /* first edge was missed */
+};
+
+/**
+ * @brief Get read statistics of "wlab,dht2x" device, collected since boot.
+ * Values are read through sensor api, sensor_sample_fetch() and
+ * sensor_channel_get() with SENSOR_CHAN_AMBIENT_TEMP or SENSOR_CHAN_HUMIDITY.
+ *
+ * @param dev Dht2x device
+ * @param stats Destination of statistics
+ */
+void dht2x_stats_get(const struct device *dev, struct dht2x_stats *stats);
 
 /**
- * @brief Initialize custom implementation of dht sensors
+ * @brief Classify bits of captured edge trace. Threshold between bit 0 and bit
+ * 1 period is derived from frame's own preamble, so sensor clock deviation is
+ * compensated. Function has no side effects, traces captured on target can be
+ * replayed.
  *
- * @param dhtx_spec const struct gpio_dt_spec *
- * @return int 0 - success, errno code otherwise
+ * @param edge_us Falling edge times, usecs since start signal was released
+ * @param cnt Number of edges, max DHT2X_EDGES_MAX
+ * @param frame Received bits, checksum in the least significant byte
+ * @param info Decoding details
+ * @return int 0 - success, -EAGAIN when trace is not complete
  */
-int dht2x_init(const struct gpio_dt_spec *dhtx_spec);
+int dht2x_frame_decode(const uint32_t *edge_us, uint32_t cnt, uint64_t *frame,
+                       struct dht2x_frame_info *info);
 
 /**
- * @brief Read DHTxy sensor value using interrupt service runtime, not blocking
- * for rtos
+ * @brief Decode 40 bit sensor frame, received msb first, humidity, temperature
+ * and checksum byte.
  *
- * @param dhtx_spec const struct gpio_dt_spec *
+ * @param frame Received bits, checksum in the least significant byte
  * @param temp Pointer to temperature value
  * @param rh Pointer to humidity value
- * @return int 0 - success, errno code otherwise
+ * @return int 0 - success, -ENOTSUP on checksum mismatch
  */
-int dht2x_read(const struct gpio_dt_spec *dhtx_spec, int16_t *temp,
-               int16_t *rh);
+int dht2x_decode(uint64_t frame, int16_t *temp, int16_t *rh);
 
 #endif /* DHT2X_H_ */
 /* ---------------------------------------------------------------------------
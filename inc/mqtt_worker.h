@@ -6,18 +6,53 @@
 #ifndef MQTT_WORKER_H_
 #define MQTT_WORKER_H_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <zephyr/net/mqtt.h>
 
 #define MQTT_WORKER_CLIENT_ID           ("zephyrux")
 #define MQTT_WORKER_MAX_TOPIC_LEN       (128)
 #define MQTT_WORKER_MAX_PAYLOAD_LEN     (256)
-#define MQTT_WORKER_MAX_PUBLISH_LEN     (512)
+#define MQTT_WORKER_MAX_PUBLISH_LEN     (CONFIG_MQTT_WORKER_MAX_PUBLISH_LEN)
 #define MQTT_WORKER_PUBLISH_ACK_TIMEOUT (4) /* seconds */
+#define MQTT_WORKER_PUBLISH_SYNC_TIMEOUT_MS                                    \
+    ((1 + CONFIG_MQTT_WORKER_PUBLISH_RETRIES) *                                \
+         MQTT_WORKER_PUBLISH_ACK_TIMEOUT * MSEC_PER_SEC +                      \
+     2 * MSEC_PER_SEC)
 
 typedef void (*subs_cb_t)(char *topic, uint16_t topic_len, char *payload,
                           uint16_t payload_len);
 
+/**
+ * @brief Serialize payload of queued message, called from worker thread right
+ * before message is sent. Called twice, first with NULL dst to get exact
+ * payload length not exceeding size, then with buffer of that length + 1,
+ * which is sent as it is.
+ *
+ * @param dst Destination buffer, NULL to compute length only
+ * @param size Destination buffer size
+ * @param user_data User data of publish request
+ * @return int Payload length, negative errno code to cancel publish
+ */
+typedef int (*mqtt_worker_encode_cb_t)(uint8_t *dst, size_t size,
+                                       void *user_data);
+
+/**
+ * @brief Report publish result, called from worker thread.
+ *
+ * @param result 0 - broker acked message, negative errno code otherwise
+ * @param user_data User data of publish request
+ */
+typedef void (*mqtt_worker_done_cb_t)(int result, void *user_data);
+
+struct mqtt_worker_pub_req {
+    const char *topic; /* has to be valid until request is done */
+    mqtt_worker_encode_cb_t encode;
+    mqtt_worker_done_cb_t done; /* optional */
+    void *user_data;
+};
+
 /**
  * @brief Initialize worker. All next action will be executed in separated
  * thread. Function is not blocked, to verify if driver is connected with broker
@@ -29,7 +64,7 @@ typedef void (*subs_cb_t)(char *topic, uint16_t topic_len, char *payload,
  * @param subs Pointer to list of topics to be subscribed, NULL if no topics
  * should be subcribed
  * @param subs_cb Function to handle data incomming to subscribed topics, NULL
- * if not needed.
+ * if not needed. Starts keepalive supervision task.
  */
 void mqtt_worker_init(const char *hostname, int32_t port, uint32_t ping_period,
                       uint32_t max_ping_no_answer,
@@ -37,17 +72,38 @@ void mqtt_worker_init(const char *hostname, int32_t port, uint32_t ping_period,
 
 /**
  * @brief Publish data to given topic. Use in the same way as typical printf().
+ * Blocks until broker acks message or all retransmissions time out, at most
+ * MQTT_WORKER_PUBLISH_SYNC_TIMEOUT_MS. Do not call from worker callbacks or
+ * scheduler tasks.
  * @param topic Topic where msg will be published
  * @return Negative errno code
  */
 int mqtt_worker_publish_qos1(const char *topic, const char *fmt, ...);
 
 /**
- * @brief Test if last keepalive response is longer than
- * CONFIG_MQTT_KEEPALIVE_TIMEOUT_MINS, if yes, then reboot device.
- *
+ * @brief Queue qos1 publish request and return immediately. Worker thread
+ * encodes, sends and tracks ack of queued messages one by one, result is
+ * reported via request done callback.
+ * @param req Publish request, copied into queue
+ * @return 0 - queued, -ENOBUFS when queue is full
+ */
+int mqtt_worker_publish_submit(const struct mqtt_worker_pub_req *req);
+
+/**
+ * @brief Queue qos1 publish request ahead of all regular requests. Worker
+ * is woken up and sends urgent request right away, in slot reserved for
+ * urgent messages when all regular in flight slots wait for PUBACK.
+ * @param req Publish request, copied into queue
+ * @return 0 - queued, -ENOBUFS when queue is full
+ */
+int mqtt_worker_publish_urgent(const struct mqtt_worker_pub_req *req);
+
+/**
+ * @brief Check if worker is connected with broker, so queued requests are
+ * sent, not dropped.
+ * @return true when connected
  */
-void mqtt_worker_keepalive_test(void);
+bool mqtt_worker_connected(void);
 
 #endif /* MQTT_WORKER_H_ */
 /* ---------------------------------------------------------------------------
@@ -14,13 +14,16 @@
 #define NVS_PARTITION_OFFSET FIXED_PARTITION_OFFSET(NVS_PARTITION)
 #define NVS_PARTITION_SIZE   FIXED_PARTITION_SIZE(NVS_PARTITION)
 
-#define NVS_ID_BOOT_COUNT        (1)
-#define NVS_ID_WIFI_CONFIG       (2)
-#define NVS_ID_MQTT_CONFIG       (3)
-#define NVS_ID_WLAB_DEVICE_ID    (4)
-#define NVS_ID_WLAB_NAME         (5)
-#define NVS_ID_WLAB_GPS_POSITION (6)
-#define NVS_ID_WLAB_PUB_PERIOD   (7)
+#define NVS_ID_BOOT_COUNT           (1)
+#define NVS_ID_WIFI_CONFIG          (2)
+#define NVS_ID_MQTT_CONFIG          (3)
+#define NVS_ID_WLAB_DEVICE_ID       (4)
+#define NVS_ID_WLAB_NAME            (5)
+#define NVS_ID_WLAB_GPS_POSITION    (6)
+#define NVS_ID_WLAB_PUB_PERIOD      (7)
+#define NVS_ID_WLAB_PAYLOAD_FMT     (8)
+#define NVS_ID_SNTP_SERVERS         (9)
+#define NVS_ID_TIMESTAMP_CHECKPOINT (10)
 
 struct wifi_config {
     char wifi_ssid[CONFIG_BUFF_MAX_STRING_LEN];
@@ -132,6 +135,51 @@ void nvs_data_wlab_pub_period_get(uint32_t *pub_period);
  */
 int nvs_data_wlab_pub_period_set(uint32_t *pub_period);
 
+/**
+ * @brief Read wlab payload format, if not exists, save json format as default.
+ *
+ * @param payload_fmt Destination of payload format, enum wlab_codec_fmt value
+ */
+void nvs_data_wlab_payload_fmt_get(uint32_t *payload_fmt);
+
+/**
+ * @brief Save wlab payload format.
+ *
+ * @param payload_fmt Pointer with data do save
+ */
+int nvs_data_wlab_payload_fmt_set(uint32_t *payload_fmt);
+
+/**
+ * @brief Read sntp server list, if not exists, save CONFIG_SNTP_SERVERS_DEFAULT
+ * as default value.
+ *
+ * @param servers Destination of comma separated server list with min size
+ * CONFIG_SNTP_SERVERS_MAX_LEN
+ */
+void nvs_data_sntp_servers_get(char *servers);
+
+/**
+ * @brief Save sntp server list.
+ *
+ * @param servers Pointer with data do save
+ */
+int nvs_data_sntp_servers_set(char *servers);
+
+/**
+ * @brief Read the last epoch checkpoint of synced clock, if not exists, save 0
+ * as default value.
+ *
+ * @param epoch_ms Destination of checkpoint, epoch millis
+ */
+void nvs_data_timestamp_checkpoint_get(int64_t *epoch_ms);
+
+/**
+ * @brief Save epoch checkpoint of synced clock.
+ *
+ * @param epoch_ms Pointer with data do save
+ */
+int nvs_data_timestamp_checkpoint_set(int64_t *epoch_ms);
+
 #endif /* NVS_DATA_H_ */
 /* ---------------------------------------------------------------------------
  * end of file
@@ -0,0 +1,75 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sample_log.h
+ * --------------------------------------------------------------------------*/
+#ifndef SAMPLE_LOG_H_
+#define SAMPLE_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+
+#define SAMPLE_LOG_PARTITION        sample_partition
+#define SAMPLE_LOG_PARTITION_DEVICE FIXED_PARTITION_DEVICE(SAMPLE_LOG_PARTITION)
+#define SAMPLE_LOG_PARTITION_OFFSET FIXED_PARTITION_OFFSET(SAMPLE_LOG_PARTITION)
+#define SAMPLE_LOG_PARTITION_SIZE   FIXED_PARTITION_SIZE(SAMPLE_LOG_PARTITION)
+
+#define SAMPLE_LOG_RECORD_MAX_LEN (128)
+
+/**
+ * @brief Mount sample log partition and recover head and tail of the log from
+ * records stored before reset.
+ *
+ */
+void sample_log_init(void);
+
+/**
+ * @brief Append record at the end of the log. When log is full the oldest
+ * record is overwritten and counted as lost. Exactly one flash write per
+ * call.
+ *
+ * @param record Pointer to record data
+ * @param len Record length, max SAMPLE_LOG_RECORD_MAX_LEN
+ * @return int 0 - success, negative errno code otherwise
+ */
+int sample_log_append(const void *record, size_t len);
+
+/**
+ * @brief Read record from the log without removing it.
+ *
+ * @param idx Record index, 0 is the oldest one
+ * @param record Destination buffer
+ * @param len Destination buffer length
+ * @return int Record length on success, negative errno code otherwise
+ */
+int sample_log_peek(uint32_t idx, void *record, size_t len);
+
+/**
+ * @brief Remove n oldest records from the log.
+ *
+ * @param n Number of records to remove
+ * @return int 0 - success, negative errno code otherwise
+ */
+int sample_log_drop(uint32_t n);
+
+/**
+ * @brief Number of records waiting in the log.
+ *
+ * @return uint32_t Records count
+ */
+uint32_t sample_log_count(void);
+
+/**
+ * @brief Number of the oldest records overwritten by append since init. Every
+ * lost record shifts indexes of records left in the log down by one, user
+ * holding indexes rebases them by the difference of two readings.
+ *
+ * @return uint32_t Lost records count, wraps around
+ */
+uint32_t sample_log_lost(void);
+
+#endif /* SAMPLE_LOG_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,42 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sntp_client.h
+ * --------------------------------------------------------------------------*/
+#ifndef SNTP_CLIENT_H_
+#define SNTP_CLIENT_H_
+
+#include <stdint.h>
+
+#define SNTP_CLIENT_MAX_SERVERS (4)
+
+struct sntp_client_result {
+    int64_t uptime_us; /* local uptime the epoch refers to */
+    int64_t epoch_us;  /* server time at uptime_us */
+    uint32_t rtt_us;   /* round trip without server processing time */
+    uint8_t server;    /* index of selected server in the list */
+    uint8_t answers;   /* valid answers received */
+    uint8_t outliers;  /* answers discarded as inconsistent */
+};
+
+/**
+ * @brief Query all servers of the list in parallel and select the answer with
+ * the lowest round trip among consistent ones. Servers whose clock offset is
+ * far from median are discarded, more than half of answers has to be
+ * consistent. Host names are resolved in parallel, limited to the first half
+ * of timeout.
+ *
+ * @param servers Comma separated list of server host names or ipv4 addresses,
+ * max SNTP_CLIENT_MAX_SERVERS used
+ * @param timeout_ms Time to wait for answers
+ * @param res Selected answer
+ * @return int 0 - success, -ETIMEDOUT when no valid answer, -ERANGE when
+ * no majority of answers is consistent, negative errno code otherwise
+ */
+int sntp_client_query(const char *servers, uint32_t timeout_ms,
+                      struct sntp_client_result *res);
+
+#endif /* SNTP_CLIENT_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
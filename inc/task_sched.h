@@ -0,0 +1,87 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: task_sched.h
+ * --------------------------------------------------------------------------*/
+#ifndef TASK_SCHED_H_
+#define TASK_SCHED_H_
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#define TASK_SCHED_STOP      (INT64_MAX)
+#define TASK_SCHED_HIST_BINS (12)
+#define TASK_SCHED_HIST_MIN  (64) /* usecs, upper bound of first bin */
+
+/**
+ * @brief Task handler.
+ *
+ * @param due_ms Uptime millis when task was due to run
+ * @return int64_t Uptime millis when task should run next time,
+ * TASK_SCHED_STOP to not run again
+ */
+typedef int64_t (*task_sched_fn_t)(int64_t due_ms);
+
+/* Histogram bin i counts values below TASK_SCHED_HIST_MIN << i usecs, the
+ * last bin counts everything above */
+struct task_sched_stats {
+    uint32_t runs;
+    uint64_t run_us_total;
+    uint32_t run_us_max;
+    uint32_t late_us_max;
+    uint32_t run_hist[TASK_SCHED_HIST_BINS];
+    uint32_t late_hist[TASK_SCHED_HIST_BINS];
+};
+
+struct task_sched_task {
+    struct k_work_delayable work;
+    const char *name;
+    task_sched_fn_t fn;
+    int64_t due_ms;
+    struct task_sched_stats stats;
+};
+
+/**
+ * @brief Start scheduler work queue. Has to be called before any task is
+ * started.
+ *
+ */
+void task_sched_init(void);
+
+/**
+ * @brief Start periodic or one shot task. All tasks are executed one by one in
+ * scheduler thread, so task handler should not block.
+ *
+ * @param task Task context, has to be valid as long as task runs
+ * @param name Task name
+ * @param fn Task handler
+ * @param due_ms Uptime millis when task should run first time
+ */
+void task_sched_start(struct task_sched_task *task, const char *name,
+                      task_sched_fn_t fn, int64_t due_ms);
+
+/**
+ * @brief Get run time and lateness statistics of started task.
+ *
+ * @param idx Task index, in order of start
+ * @param name Destination of task name
+ * @param stats Destination of statistics
+ * @return int 0 - success, -ENOENT when no task with given index
+ */
+int task_sched_stats_get(uint32_t idx, const char **name,
+                         struct task_sched_stats *stats);
+
+/**
+ * @brief Check liveness of started tasks. Task overdue by more than
+ * CONFIG_TASK_SCHED_STALL_MS is stuck, or a task before it in scheduler queue
+ * is.
+ *
+ * @return const char* Name of the first stalled task, NULL when all tasks run
+ * in time
+ */
+const char *task_sched_stalled(void);
+
+#endif /* TASK_SCHED_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -6,11 +6,37 @@
 #ifndef TIMESTAMP_H_
 #define TIMESTAMP_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* Source of clock estimate used until the first sntp sync */
+enum timestamp_start {
+    TIMESTAMP_START_COLD = 0, /* no estimate, clock starts at epoch 0 */
+    TIMESTAMP_START_NVS,      /* the last checkpoint stored in nvs */
+    TIMESTAMP_START_RETAINED, /* epoch retained in ram by warm reset */
+};
+
+struct timestamp_stats {
+    uint32_t syncs;
+    uint32_t failures;
+    uint32_t rtt_us_last; /* round trip of selected server answer */
+    uint32_t rtt_us_max;
+    int32_t offset_us_last; /* server minus local clock at sync */
+    uint32_t offset_us_max; /* absolute, first sync excluded */
+    int32_t freq_ppb;       /* estimated local oscillator offset */
+    uint32_t period_sec;    /* actual resync period */
+    uint8_t server;         /* index of server selected at the last sync */
+    uint8_t answers;        /* valid answers at the last sync */
+    uint32_t outliers;      /* answers discarded as inconsistent */
+    uint8_t start;          /* enum timestamp_start */
+};
+
 /**
- * @brief Initialize timestamp module, use sntp to get real epoch time. When no
- * possibilities to sync time - reboot cpu.
+ * @brief Initialize timestamp module. Clock starts immediately from epoch
+ * retained by warm reset or from the last nvs checkpoint, it is flagged as
+ * unsynced until sntp answers. Sync runs in background work queue, servers
+ * from nvs list are queried in parallel, readers of timestamp never wait for
+ * sntp.
  *
  */
 void timestamp_init(void);
@@ -18,15 +44,50 @@ void timestamp_init(void);
 /**
  * @brief Actual epoch timestamp.
  *
- * @return int64_t Actual epoch timestamp millis.
+ * @return int64_t Actual epoch timestamp secs.
  */
 int64_t timestamp_get(void);
 
 /**
- * @brief Update internal timer to be up-to-date with epoch time.
+ * @brief Actual epoch timestamp of local clock disciplined by sntp. Frequency
+ * offset of local oscillator is compensated and small offsets are slewed, so
+ * the time never steps back unless offset is larger than 1 s.
+ *
+ * @return int64_t Actual epoch timestamp millis.
+ */
+int64_t timestamp_get_ms(void);
+
+/**
+ * @brief Actual epoch timestamp together with clock state, read atomically.
+ *
+ * @param synced Set when clock has been synced by sntp, timestamp of unsynced
+ * clock is only an estimate to be fixed by timestamp_unsynced_correct()
+ * @return int64_t Actual epoch timestamp secs.
+ */
+int64_t timestamp_get_checked(bool *synced);
+
+/**
+ * @brief Check whether clock has been synced by sntp since boot.
+ *
+ * @return bool True when synced
+ */
+bool timestamp_synced(void);
+
+/**
+ * @brief Correct timestamp taken before the first sync by the step the clock
+ * made at the first sync.
+ *
+ * @param ts Epoch secs read from unsynced clock, corrected in place
+ * @return int 0 - success, -EAGAIN when clock is still unsynced
+ */
+int timestamp_unsynced_correct(uint32_t *ts);
+
+/**
+ * @brief Get sntp synchronization statistics, collected since boot.
  *
+ * @param stats Destination of statistics
  */
-void timestamp_update(void);
+void timestamp_stats_get(struct timestamp_stats *stats);
 
 #endif /* TIMESTAMP_H_ */
 /* ---------------------------------------------------------------------------
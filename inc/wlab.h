@@ -8,18 +8,62 @@
 
 #include <stdint.h>
 
+#include "wlab_slide.h"
+
 /**
- * @brief Initialize weatherlab service with provided sensor type
+ * @brief Initialize weatherlab service with provided sensor type and start
+ * measure and aggregation tasks. Network is not needed, sampling starts
+ * before wifi and sntp are up.
  *
  */
 void wlab_init(void);
 
 /**
- * @brief Do sensor measurement and publish to weatherlab if needed
+ * @brief Authorize station at broker and enable publishing of stored
+ * records, call once mqtt worker is connected.
+ *
+ */
+void wlab_connect(void);
+
+struct wlab_serie_stats {
+    const char *name;
+    uint32_t accepted; /* raw readings passed outlier filter */
+    uint32_t rejected; /* raw readings rejected as outliers */
+};
+
+struct wlab_window_stats {
+    uint32_t closed;     /* all windows closed since boot */
+    uint32_t empty;      /* stored as empty record */
+    uint32_t partial;    /* stored as partial record */
+    uint32_t suppressed; /* within deadband, not stored nor published */
+};
+
+/**
+ * @brief Get runtime statistics of serie.
+ *
+ * @param idx Serie index
+ * @param stats Destination of statistics
+ * @return int 0 - success, -ENOENT when no serie with given index
+ */
+int wlab_serie_stats_get(uint32_t idx, struct wlab_serie_stats *stats);
+
+/**
+ * @brief Get statistics of closed aggregation windows.
+ *
+ * @param stats Destination of statistics
+ */
+void wlab_window_stats_get(struct wlab_window_stats *stats);
+
+/**
+ * @brief Get rolling values of serie over the last
+ * CONFIG_WLAB_SLIDE_WINDOW_SECS, updated with every accepted sample.
  *
- * @param timestamp_secs Actual epoch time in seconds
+ * @param idx Serie index
+ * @param value Destination of rolling values
+ * @return int 0 - success, -ENOENT when no serie with given index, -ENODATA
+ * when no sample in window
  */
-void wlab_process(int64_t timestamp_secs);
+int wlab_serie_slide_get(uint32_t idx, struct wlab_slide_value *value);
 
 #endif /* WLAB_H_ */
 /* ---------------------------------------------------------------------------
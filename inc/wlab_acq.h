@@ -0,0 +1,68 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_acq.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_ACQ_H_
+#define WLAB_ACQ_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#include "wlab_series.h"
+
+#define WLAB_ACQ_HIST_BINS (12)
+#define WLAB_ACQ_HIST_MIN  (64) /* usecs, upper bound of first bin */
+
+/* Raw reading of all series, taken at one timer tick */
+struct wlab_acq_sample {
+    uint32_t ts;    /* epoch secs */
+    bool synced;    /* ts taken from sntp synced clock, otherwise estimate */
+    uint32_t valid; /* bit i set when value of serie i was read */
+    int32_t val[WLAB_SERIES_CNT]; /* 1/scale unit of serie */
+};
+
+/* Histogram bin i counts values below WLAB_ACQ_HIST_MIN << i usecs, the last
+ * bin counts everything above */
+struct wlab_acq_stats {
+    uint32_t samples;
+    uint32_t missed;  /* timer periods without sample, read overran period */
+    uint32_t dropped; /* samples lost, queue full */
+    uint32_t read_us_max;
+    uint32_t jitter_us_max; /* deviation of sample interval from period */
+    uint32_t jitter_hist[WLAB_ACQ_HIST_BINS];
+    uint32_t period_ms;      /* actual sample period */
+    uint32_t period_changes; /* adaptive period changes */
+};
+
+/**
+ * @brief Start acquisition thread. All series are read on every tick of
+ * periodic timer and the sample is queued for aggregation. Period starts at
+ * CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC and backs off up to
+ * CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC while series with adapt-rate set in
+ * devicetree stay flat.
+ *
+ */
+void wlab_acq_start(void);
+
+/**
+ * @brief Get the oldest queued sample.
+ *
+ * @param sample Destination of sample
+ * @param timeout Time to wait for sample
+ * @return int 0 - success, -ENOMSG or -EAGAIN when no sample is queued
+ */
+int wlab_acq_get(struct wlab_acq_sample *sample, k_timeout_t timeout);
+
+/**
+ * @brief Get acquisition statistics, collected since start.
+ *
+ * @param stats Destination of statistics
+ */
+void wlab_acq_stats_get(struct wlab_acq_stats *stats);
+
+#endif /* WLAB_ACQ_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,79 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_alarm.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_ALARM_H_
+#define WLAB_ALARM_H_
+
+#include <stdint.h>
+
+#include "wlab_acq.h"
+
+enum wlab_alarm_kind {
+    WLAB_ALARM_HIGH = 0,
+    WLAB_ALARM_LOW,
+    WLAB_ALARM_RATE,
+    WLAB_ALARM_KINDS,
+};
+
+/* Latency is measured from sensor read to PUBACK of alarm message */
+struct wlab_alarm_stats {
+    uint32_t raised;
+    uint32_t cleared;
+    uint32_t published; /* acked by broker */
+    uint32_t failed;    /* not acked or queue full, retried */
+    uint32_t latency_ms_last;
+    uint32_t latency_ms_max;
+    uint64_t latency_ms_sum; /* of published alarms */
+};
+
+/**
+ * @brief Start publishing of alarms. Alarms are evaluated from the very first
+ * sample, state reached before start is published on first check after.
+ *
+ * @param uid Station uid, hex string, has to stay valid
+ */
+void wlab_alarm_start(const char *uid);
+
+/**
+ * @brief Evaluate alarm rules of every serie on raw sample, called by
+ * acquisition thread right after read. Alarm changes state once
+ * CONFIG_WLAB_ALARM_CONFIRM_SAMPLES samples in a row agree on it. Every alarm
+ * whose state differs from the one last acked by broker is queued for
+ * publishing at once, ahead of regular traffic, so change lost while
+ * disconnected is sent on reconnect.
+ *
+ * @param sample Raw sample
+ * @param read_us Uptime usecs of sensor read
+ */
+void wlab_alarm_check(const struct wlab_acq_sample *sample, int64_t read_us);
+
+/**
+ * @brief Get bit mask of active alarms of serie, bit i set when alarm of
+ * kind i is raised.
+ *
+ * @param idx Serie index
+ * @return uint32_t Active alarms
+ */
+uint32_t wlab_alarm_active_get(uint32_t idx);
+
+/**
+ * @brief Name of alarm kind, as published.
+ *
+ * @param kind Alarm kind
+ * @return const char* Name
+ */
+const char *wlab_alarm_kind_name(enum wlab_alarm_kind kind);
+
+/**
+ * @brief Get alarm statistics, collected since start.
+ *
+ * @param stats Destination of statistics
+ */
+void wlab_alarm_stats_get(struct wlab_alarm_stats *stats);
+
+#endif /* WLAB_ALARM_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,34 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_bench.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_BENCH_H_
+#define WLAB_BENCH_H_
+
+#include <stdint.h>
+
+#define WLAB_BENCH_ITERATIONS (100)
+
+struct wlab_bench_result {
+    const char *name;
+    uint32_t cycles; /* per call */
+    uint32_t bytes;  /* output of single call */
+    uint32_t stack;  /* bytes of benchmark thread stack used */
+};
+
+/**
+ * @brief Run single on-target benchmark of wlab hot path, WLAB_BENCH_ITERATIONS
+ * calls on synthetic data in separate thread. Not reentrant.
+ *
+ * @param idx Benchmark index
+ * @param res Destination of result
+ * @return int 0 - success, -ENOENT when no benchmark with given index,
+ * negative errno code of benchmarked function otherwise
+ */
+int wlab_bench_run(uint32_t idx, struct wlab_bench_result *res);
+
+#endif /* WLAB_BENCH_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
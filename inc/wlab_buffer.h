@@ -0,0 +1,61 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_buffer.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_BUFFER_H_
+#define WLAB_BUFFER_H_
+
+#include <stdint.h>
+
+#include "wlab_codec.h"
+#include "wlab_stats.h"
+
+/* Aggregation of one serie over publish period */
+struct wlab_buffer {
+    int32_t _min;
+    int32_t _max;
+    uint32_t _max_ts;
+    uint32_t _min_ts;
+    int32_t buff;
+    int32_t cnt;
+    uint32_t sample_ts;
+    int32_t sample_ts_val;
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    struct wlab_stats_var var;
+    struct wlab_stats_p2 quantile;
+#endif
+};
+
+/**
+ * @brief Clear buffer before next publish period.
+ *
+ * @param buffer Pointer to buffer
+ */
+void wlab_buffer_init(struct wlab_buffer *buffer);
+
+/**
+ * @brief Add accepted reading to buffer.
+ *
+ * @param buffer Pointer to buffer
+ * @param val Reading in 1/scale unit of serie
+ * @param ts Epoch secs of reading
+ * @param period_secs Publish period, buffer timestamp is aligned to it
+ */
+void wlab_buffer_commit(struct wlab_buffer *buffer, int32_t val, uint32_t ts,
+                        uint32_t period_secs);
+
+/**
+ * @brief Fill record serie with aggregated values, serie of empty buffer is
+ * zeroed.
+ *
+ * @param serie Destination record serie
+ * @param buffer Pointer to buffer
+ */
+void wlab_buffer_fill(struct wlab_record_serie *serie,
+                      const struct wlab_buffer *buffer);
+
+#endif /* WLAB_BUFFER_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,131 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_codec.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_CODEC_H_
+#define WLAB_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+#include "wlab_series.h"
+
+#define WLAB_CODEC_UID_LEN     (12) /* hex string, without \0 */
+#define WLAB_CODEC_NUM_MAX_LEN (13) /* formatted int32 with \0 */
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+#define WLAB_CODEC_BIN_VERSION (2)
+#else
+#define WLAB_CODEC_BIN_VERSION (1)
+#endif
+
+/* Record flags, record without any flag covers the whole window */
+#define WLAB_RECORD_EMPTY   BIT(0) /* no sample in window, series zeroed */
+#define WLAB_RECORD_PARTIAL BIT(1) /* window not covered by samples */
+#define WLAB_RECORD_FILL    BIT(2) /* windows since previous record were
+                                    * within deadband, forward fill them */
+
+/**
+ * Binary payload, version 1 (version 2 with CONFIG_WLAB_STATS_EXTENDED), all
+ * numbers little endian:
+ *
+ *  offset  size  field
+ *  0       1     version, WLAB_CODEC_BIN_VERSION
+ *  1       1     N, number of records
+ *  2       6     UID, 48 bit big endian
+ *  8       1     S, number of series in every record
+ *  9       S     serie ids, in order of appearance in record
+ *  9+S     ...   N records
+ *
+ *  record:
+ *  0       4     TS, window epoch secs (uint32)
+ *  4       1     flags, WLAB_RECORD_EMPTY | WLAB_RECORD_PARTIAL |
+ *                WLAB_RECORD_FILL
+ *  5       14*S  series: avg, act, min, max (int16, 1/scale unit of
+ *                serie), min_ts, max_ts (uint16, secs since TS, 0xFFFF -
+ *                none), cnt (uint16, samples in window)
+ *
+ *  version 2 serie is 18 bytes, version 1 fields followed by std (uint16)
+ *  and quantile (int16) in 1/scale unit of serie.
+ *
+ * Example, UID 0A1B2C3D4E5F, TS 1700000000, temperature (id 1, scale 10)
+ * 21.5 act 21.7 min 20.9 (TS+60) max 22.0 (TS+420), humidity (id 2, scale
+ * 10) 45.0 act 44.8 min 43.1 (TS+540) max 46.2 (TS+0), 150 samples each:
+ *
+ *  01 01 0A 1B 2C 3D 4E 5F 02 01 02
+ *  00 F1 53 65 00
+ *  D7 00 D9 00 D1 00 DC 00 3C 00 A4 01 96 00
+ *  C2 01 C0 01 AF 01 CE 01 1C 02 00 00 96 00
+ */
+
+enum wlab_codec_fmt {
+    WLAB_CODEC_JSON = 0,
+    WLAB_CODEC_BIN = 1,
+};
+
+/* Finished aggregation window, as stored in sample log */
+struct wlab_record_serie {
+    int32_t avg;
+    int32_t act;
+    int32_t min;
+    int32_t max;
+    uint32_t min_ts;
+    uint32_t max_ts;
+    uint32_t cnt; /* accepted samples, sample period is adaptive */
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    int32_t std;
+    int32_t quantile;
+#endif
+} __packed;
+
+struct wlab_record {
+    uint32_t ts;
+    uint8_t flags;
+    struct wlab_record_serie serie[WLAB_SERIES_CNT];
+} __packed;
+
+/**
+ * @brief Encode records as one message in requested format. Encoder puts as
+ * many records as fits into dst. With NULL dst nothing is written, only exact
+ * payload length of records fitting into size is computed, so payload can be
+ * encoded straight into buffer of that length (+1 for json \0). Json is an
+ * array of records whenever CONFIG_WLAB_PUB_BATCH_SIZE is above 1, a single
+ * object otherwise.
+ *
+ * @param fmt Payload format
+ * @param uid Station uid, hex string
+ * @param records Records to encode
+ * @param cnt In: number of records, out: number of encoded records
+ * @param dst Destination buffer, NULL to compute length only
+ * @param size Destination buffer size
+ * @return int Payload length, negative errno code otherwise
+ */
+int wlab_codec_encode(enum wlab_codec_fmt fmt, const char *uid,
+                      const struct wlab_record *records, uint32_t *cnt,
+                      uint8_t *dst, size_t size);
+
+/**
+ * @brief Render series part of authorization message, json object of serie
+ * name to serie id.
+ *
+ * @param dst Destination buffer
+ * @param size Destination buffer size
+ * @return int Length of rendered string, negative errno code otherwise
+ */
+int wlab_codec_auth_series(char *dst, size_t size);
+
+/**
+ * @brief Format fixed point value as decimal number.
+ *
+ * @param dst Destination buffer, min WLAB_CODEC_NUM_MAX_LEN bytes
+ * @param signed_int Value in 1/scale unit
+ * @param scale Power of 10
+ * @return int Length of formatted number, without \0
+ */
+int wlab_itostrf(char *dst, int32_t signed_int, uint32_t scale);
+
+#endif /* WLAB_CODEC_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,50 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_filter.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_FILTER_H_
+#define WLAB_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Hampel filter over ring of recent raw readings */
+struct wlab_filter {
+    int32_t ring[CONFIG_WLAB_FILTER_WINDOW_MAX];
+    uint8_t size;
+    uint8_t head;
+    uint8_t cnt;
+    uint32_t accepted;
+    uint32_t rejected;
+};
+
+/**
+ * @brief Initialize filter.
+ *
+ * @param filter Pointer to filter
+ * @param window Number of recent raw readings taken into account, limited to
+ * CONFIG_WLAB_FILTER_WINDOW_MAX
+ */
+void wlab_filter_init(struct wlab_filter *filter, uint32_t window);
+
+/**
+ * @brief Put raw reading into filter and check if it is an outlier. Reading is
+ * rejected when its distance to median of recent readings exceeds nsigma
+ * times scaled median absolute deviation, but never when distance is below
+ * min_tolerance. Readings are accepted until at least 3 are collected.
+ *
+ * @param filter Pointer to filter
+ * @param val Raw reading
+ * @param nsigma_x10 Rejection threshold in 0.1 sigma unit
+ * @param min_tolerance Distance from median always accepted
+ * @return true Reading accepted
+ * @return false Reading rejected as outlier
+ */
+bool wlab_filter_check(struct wlab_filter *filter, int32_t val,
+                       uint32_t nsigma_x10, int32_t min_tolerance);
+
+#endif /* WLAB_FILTER_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
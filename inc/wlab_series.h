@@ -0,0 +1,43 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_series.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_SERIES_H_
+#define WLAB_SERIES_H_
+
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor.h>
+
+#define WLAB_SERIES_NODE DT_NODELABEL(wlab_series)
+#define WLAB_SERIES_CNT  DT_CHILD_NUM_STATUS_OKAY(WLAB_SERIES_NODE)
+
+#define WLAB_SERIE_ALARM_NONE_HIGH (INT32_MAX)
+#define WLAB_SERIE_ALARM_NONE_LOW  (INT32_MIN)
+
+struct wlab_serie_desc {
+    uint8_t id;
+    const char *name;
+    const struct device *sensor;
+    enum sensor_channel channel;
+    uint32_t scale;
+    int32_t threshold;
+    uint32_t filter_window;
+    uint32_t filter_nsigma; /* 0.1 sigma unit */
+    uint32_t adapt_rate;    /* 1/scale unit per minute, 0 - none */
+    int32_t deadband;
+    int32_t alarm_high; /* WLAB_SERIE_ALARM_NONE_HIGH - none */
+    int32_t alarm_low;  /* WLAB_SERIE_ALARM_NONE_LOW - none */
+    int32_t alarm_hyst;
+    uint32_t alarm_rate; /* 1/scale unit per minute, 0 - none */
+};
+
+/* Series enabled in devicetree, WLAB_SERIES_CNT entries */
+extern const struct wlab_serie_desc WlabSeries[];
+
+#endif /* WLAB_SERIES_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
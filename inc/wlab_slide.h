@@ -0,0 +1,78 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_slide.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_SLIDE_H_
+#define WLAB_SLIDE_H_
+
+#include <stdint.h>
+
+#define WLAB_SLIDE_LEN (CONFIG_WLAB_SLIDE_SAMPLES_MAX)
+
+/* Monotonic deque of sample sequence numbers, positions grow forever and
+ * are taken modulo WLAB_SLIDE_LEN */
+struct wlab_slide_deque {
+    uint32_t seq[WLAB_SLIDE_LEN];
+    uint32_t front;
+    uint32_t back;
+};
+
+/* Sliding window of one serie over the last CONFIG_WLAB_SLIDE_WINDOW_SECS.
+ * Sample with sequence number s is kept in ring slot s % WLAB_SLIDE_LEN,
+ * samples of window are [tail, head). Min deque holds increasing values,
+ * max deque decreasing ones, so window min and max are at deque fronts. */
+struct wlab_slide {
+    int32_t val[WLAB_SLIDE_LEN];
+    uint32_t ts[WLAB_SLIDE_LEN];
+    uint32_t head;
+    uint32_t tail;
+    int64_t sum;
+    struct wlab_slide_deque min;
+    struct wlab_slide_deque max;
+};
+
+/* Rolling values of sliding window */
+struct wlab_slide_value {
+    int32_t avg;
+    int32_t min;
+    int32_t max;
+    uint32_t min_ts;
+    uint32_t max_ts;
+    uint32_t cnt;
+    uint32_t first_ts; /* the oldest sample in window */
+};
+
+/**
+ * @brief Clear sliding window.
+ *
+ * @param slide Pointer to window
+ */
+void wlab_slide_init(struct wlab_slide *slide);
+
+/**
+ * @brief Add sample to sliding window, samples expired at ts are evicted.
+ * Amortized O(1) time, every sample enters and leaves each deque once. When
+ * window holds WLAB_SLIDE_LEN samples the oldest one is evicted.
+ *
+ * @param slide Pointer to window
+ * @param val Sample in 1/scale unit of serie
+ * @param ts Epoch secs of sample, not older than previous sample
+ */
+void wlab_slide_add(struct wlab_slide *slide, int32_t val, uint32_t ts);
+
+/**
+ * @brief Get rolling values of samples not expired at ts.
+ *
+ * @param slide Pointer to window
+ * @param ts Actual epoch secs
+ * @param value Destination of rolling values
+ * @return int 0 - success, -ENODATA when window is empty
+ */
+int wlab_slide_get(struct wlab_slide *slide, uint32_t ts,
+                   struct wlab_slide_value *value);
+
+#endif /* WLAB_SLIDE_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
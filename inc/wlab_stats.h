@@ -0,0 +1,80 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_stats.h
+ * --------------------------------------------------------------------------*/
+#ifndef WLAB_STATS_H_
+#define WLAB_STATS_H_
+
+#include <stdint.h>
+
+#define WLAB_STATS_P2_MARKERS (5)
+
+/* Welford running variance, mean and m2 in Q16 fixed point */
+struct wlab_stats_var {
+    uint32_t n;
+    int64_t mean;
+    int64_t m2;
+};
+
+/* P-square quantile estimator, marker heights in Q8 fixed point, desired
+ * positions in Q16 fixed point */
+struct wlab_stats_p2 {
+    uint32_t n;
+    uint32_t p; /* quantile, per mille */
+    int32_t q[WLAB_STATS_P2_MARKERS];
+    int32_t pos[WLAB_STATS_P2_MARKERS];
+    int64_t want[WLAB_STATS_P2_MARKERS];
+};
+
+/**
+ * @brief Reset running variance.
+ *
+ * @param var Pointer to estimator
+ */
+void wlab_stats_var_init(struct wlab_stats_var *var);
+
+/**
+ * @brief Add sample to running variance, O(1) time and memory.
+ *
+ * @param var Pointer to estimator
+ * @param val Sample value
+ */
+void wlab_stats_var_add(struct wlab_stats_var *var, int32_t val);
+
+/**
+ * @brief Sample standard deviation of added values, rounded to value unit.
+ *
+ * @param var Pointer to estimator
+ * @return int32_t Standard deviation, 0 when less than 2 samples
+ */
+int32_t wlab_stats_var_stddev(const struct wlab_stats_var *var);
+
+/**
+ * @brief Reset quantile estimator.
+ *
+ * @param p2 Pointer to estimator
+ * @param permille Quantile to estimate, 500 is median
+ */
+void wlab_stats_p2_init(struct wlab_stats_p2 *p2, uint32_t permille);
+
+/**
+ * @brief Add sample to quantile estimator, O(1) time and memory.
+ *
+ * @param p2 Pointer to estimator
+ * @param val Sample value
+ */
+void wlab_stats_p2_add(struct wlab_stats_p2 *p2, int32_t val);
+
+/**
+ * @brief Approximate quantile of added values, rounded to value unit.
+ *
+ * @param p2 Pointer to estimator
+ * @return int32_t Quantile estimation, 0 when no samples
+ */
+int32_t wlab_stats_p2_get(const struct wlab_stats_p2 *p2);
+
+#endif /* WLAB_STATS_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -14,6 +14,7 @@
 #include "dht2x.h"
 #include "mqtt_worker.h"
 #include "nvs_data.h"
+#include "task_sched.h"
 #include "timestamp.h"
 #include "version.h"
 #include "wdg.h"
@@ -22,6 +23,12 @@
 
 LOG_MODULE_REGISTER(MAIN, LOG_LEVEL_DBG);
 
+#define MAIN_WDG_STACK_SIZE (1024)
+#define MAIN_WDG_PRIORITY   (1)
+
+K_THREAD_STACK_DEFINE(WdgStack, MAIN_WDG_STACK_SIZE);
+static struct k_thread WdgThread;
+
 static const struct gpio_dt_spec InfoLed =
     GPIO_DT_SPEC_GET(DT_NODELABEL(info_led), gpios);
 
@@ -29,6 +36,31 @@ static const struct gpio_dt_spec ConfigButton =
     GPIO_DT_SPEC_GET(DT_NODELABEL(config_btn), gpios);
 
 static bool ConfigureMode = false;
+static struct task_sched_task HeartbeatTask;
+
+/**
+ * @brief Feed watchdog every second as long as no scheduler task is stalled.
+ * Runs above scheduler priority, so a long task run does not starve it.
+ */
+static void main_wdg_proc(void *arg1, void *arg2, void *arg3) {
+    for (;;) {
+        const char *stalled = task_sched_stalled();
+        if (NULL == stalled) {
+            wdg_feed();
+        } else {
+            LOG_ERR("Task %s stalled, watchdog not fed", stalled);
+        }
+        k_sleep(K_SECONDS(1));
+    }
+}
+
+/**
+ * @brief Blink info led, slow blinking in configure mode.
+ */
+static int64_t main_heartbeat_task(int64_t due_ms) {
+    gpio_pin_toggle_dt(&InfoLed);
+    return (due_ms + (ConfigureMode ? 2000 : 1000));
+}
 
 int main(void) {
     int ret = 0;
@@ -48,40 +80,40 @@ int main(void) {
     __ASSERT((0 == ret), "Config button init failed");
 
     nvs_data_init();
+    task_sched_init();
+
+    /* watchdog is fed from now on, also while network is being brought up
+     * and station authorized */
+    k_thread_create(&WdgThread, WdgStack, K_THREAD_STACK_SIZEOF(WdgStack),
+                    main_wdg_proc, NULL, NULL, NULL, MAIN_WDG_PRIORITY, 0,
+                    K_NO_WAIT);
+    k_thread_name_set(&WdgThread, "wdg");
 
     if (gpio_pin_get_dt(&ConfigButton)) {
         LOG_WRN("CONFIG MODE ENABLED");
         ConfigureMode = true;
     }
 
+    task_sched_start(&HeartbeatTask, "heartbeat", main_heartbeat_task,
+                     k_uptime_get());
+
     if (ConfigureMode) {
         ; /* For future use... Start wifi accesspoint */
     } else {
+        /* sampling starts on estimated time, before network is up */
+        timestamp_init();
+        wlab_init();
         nvs_data_wifi_config_get(&wificfg);
         wifi_net_init(wificfg.wifi_ssid, wificfg.wifi_pass);
         nvs_data_mqtt_config_get(&mqttcfg);
         mqtt_worker_init(mqttcfg.mqtt_broker, mqttcfg.mqtt_port,
                          mqttcfg.mqtt_ping_period,
                          mqttcfg.mqtt_max_ping_no_answer, NULL, NULL);
-        timestamp_init();
-        wlab_init();
+        wlab_connect();
     }
 
-    for (;;) {
-        wdg_feed();
-        gpio_pin_toggle_dt(&InfoLed);
-
-        if (ConfigureMode) {
-            k_sleep(K_MSEC(2000));
-            continue;
-        }
-
-        k_sleep(K_MSEC(200));
-        int64_t ts_now = timestamp_get();
-        wlab_process(ts_now);
-        timestamp_update();
-        mqtt_worker_keepalive_test();
-    }
+    /* everything else runs in scheduler tasks */
+    return (0);
 }
 
 /* ---------------------------------------------------------------------------
@@ -3,134 +3,324 @@
  * ---------------------------------------------------------------------------
  *  Name: dht2x.h
  * --------------------------------------------------------------------------*/
+#define DT_DRV_COMPAT wlab_dht2x
+
 #include "dht2x.h"
 
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/sensor.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 LOG_MODULE_REGISTER(DHTx, LOG_LEVEL_DBG);
 
-struct gpio_callback IrqCb;
-K_SEM_DEFINE(DhtReadDone, 0, 1);
+/* Nominal timing from datasheet: response 80us low + 80us high, every bit
+ * 50us low followed by 26-28us (0) or 70us (1) high. Threshold is midpoint
+ * between 0 and 1 bit period, scaled by measured preamble. */
+#define DHT2X_FIRST_EDGE_MAX_US   (100)
+#define DHT2X_PREAMBLE_US         (160)
+#define DHT2X_PREAMBLE_MIN_US     (120)
+#define DHT2X_PREAMBLE_MAX_US     (200)
+#define DHT2X_BIT_THRESHOLD_US    (98)
+
+struct dht2x_config {
+    struct gpio_dt_spec dio;
+    uint32_t frame_timeout_ms;
+};
+
+struct dht2x_data {
+    const struct device *dev;
+    struct gpio_callback irq_cb;
+    struct k_sem read_done;
+    struct k_mutex lock; /* one read of instance at a time */
+
+    /* Raw falling edge stamps of current frame, written by gpio isr only */
+    volatile uint32_t edges[DHT2X_EDGES_MAX];
+    volatile uint32_t edge_cnt;
+
+    int16_t temp; /* last fetched values, 0.1 unit */
+    int16_t rh;
 
-static volatile uint32_t PulseStartUs = 0;
-static volatile uint32_t PulseCnt = 0;
-static volatile uint64_t ReadData = 0;
-static volatile uint32_t LastElapsed = 0;
+    /* Written by fetching thread, read by any, under stats_lock */
+    struct dht2x_stats stats;
+    struct k_spinlock stats_lock;
+};
 
-static uint32_t dht2x_us_now(void) {
-    uint64_t cyc = k_cycle_get_32();
-    uint64_t cyc_per_us =
-        ((uint32_t)sys_clock_hw_cycles_per_sec()) / (uint32_t)USEC_PER_SEC;
-    return (cyc / cyc_per_us);
+static uint32_t dht2x_hist_bin(uint32_t val, uint32_t min, uint32_t step,
+                               uint32_t bins) {
+    if (val < min) {
+        return (0);
+    }
+    return (MIN((val - min) / step, bins - 1));
 }
 
-static void gpio_callback(const struct device *dev, struct gpio_callback *cb,
-                          uint32_t pin) {
-    /* DHT21 = AM2301 sends 64 bit, only first 40bis include data */
-    uint32_t us_now = dht2x_us_now();
-    LastElapsed = us_now - PulseStartUs;
-    if (0 == PulseCnt) {
-        if (LastElapsed > 100) {
-            PulseCnt += 2;
-            /* Sometime we are not able to catch first falling edge, if this
-             * situation occure then second elapsed is ~180us. First edge
-             * should be < 30us */
-        }
-    } else if (1 == PulseCnt) {
-        PulseCnt++;
+static void gpio_callback(const struct device *port, struct gpio_callback *cb,
+                          uint32_t pins) {
+    struct dht2x_data *data = CONTAINER_OF(cb, struct dht2x_data, irq_cb);
+    const struct dht2x_config *cfg = data->dev->config;
+
+    /* only stamp the edge, frame is decoded by reading thread */
+    uint32_t cnt = data->edge_cnt;
+    if (cnt < DHT2X_EDGES_MAX) {
+        data->edges[cnt++] = k_cycle_get_32();
+        data->edge_cnt = cnt;
+    }
+
+    if (DHT2X_EDGES_MAX == cnt) {
+        gpio_pin_interrupt_configure_dt(&cfg->dio, GPIO_INT_DISABLE);
+        k_sem_give(&data->read_done);
+    }
+}
+
+/**
+ * @brief Account one read, all counters are updated under the same lock the
+ * reader takes, so snapshot of statistics is always consistent.
+ */
+static void dht2x_stats_update(struct dht2x_data *data, int frame_rc,
+                               int decode_rc, const uint32_t *edge_us,
+                               uint32_t cnt,
+                               const struct dht2x_frame_info *info,
+                               uint32_t latency_us) {
+    struct dht2x_stats *stats = &data->stats;
+
+    k_spinlock_key_t key = k_spin_lock(&data->stats_lock);
+    stats->threshold_us = info->threshold_us;
+    if (0 != frame_rc) {
+        stats->timeouts++;
+        stats->timeout_hist[MIN(cnt / DHT2X_TIMEOUT_HIST_STEP_CNT,
+                                DHT2X_TIMEOUT_HIST_BINS - 1)]++;
     } else {
-        if (LastElapsed <= 110) { /* bit 0 */
-            ReadData = ReadData << 1;
-        } else if (LastElapsed > 110) { /* bit 1 */
-            ReadData = (ReadData << 1) | 1;
-        } else { /* bit timing failed */
-            gpio_pin_interrupt_configure(dev, pin, GPIO_INT_DISABLE);
-            k_sem_give(&DhtReadDone);
+        stats->recovered += info->recovered ? 1 : 0;
+        stats->checksum_errors += (0 != decode_rc) ? 1 : 0;
+        for (uint32_t i = 1; i < cnt; i++) {
+            stats->pulse_hist[dht2x_hist_bin(
+                edge_us[i] - edge_us[i - 1], DHT2X_PULSE_HIST_MIN_US,
+                DHT2X_PULSE_HIST_STEP_US, DHT2X_PULSE_HIST_BINS)]++;
+        }
+    }
+    stats->reads++;
+    stats->latency_max_us = MAX(stats->latency_max_us, latency_us);
+    stats->latency_hist[dht2x_hist_bin(
+        latency_us / USEC_PER_MSEC, DHT2X_LATENCY_HIST_MIN_MS,
+        DHT2X_LATENCY_HIST_STEP_MS, DHT2X_LATENCY_HIST_BINS)]++;
+    k_spin_unlock(&data->stats_lock, key);
+}
+
+void dht2x_stats_get(const struct device *dev, struct dht2x_stats *stats) {
+    struct dht2x_data *data = dev->data;
+
+    k_spinlock_key_t key = k_spin_lock(&data->stats_lock);
+    memcpy(stats, &data->stats, sizeof(struct dht2x_stats));
+    k_spin_unlock(&data->stats_lock, key);
+}
+
+int dht2x_frame_decode(const uint32_t *edge_us, uint32_t cnt, uint64_t *frame,
+                       struct dht2x_frame_info *info) {
+    uint32_t first = 0;
+
+    info->threshold_us = DHT2X_BIT_THRESHOLD_US;
+    info->recovered = false;
+
+    if (0 == cnt) {
+        return (-EAGAIN);
+    }
+
+    if (edge_us[0] > DHT2X_FIRST_EDGE_MAX_US) {
+        /* Sometime we are not able to catch first falling edge, if this
+         * situation occure then first elapsed is ~180us. First edge should
+         * be < 30us. Preamble is lost, nominal threshold is used. */
+        info->recovered = true;
+    } else if (1 < cnt) {
+        uint32_t preamble = edge_us[1] - edge_us[0];
+        if ((DHT2X_PREAMBLE_MIN_US <= preamble) &&
+            (preamble <= DHT2X_PREAMBLE_MAX_US)) {
+            info->threshold_us =
+                preamble * DHT2X_BIT_THRESHOLD_US / DHT2X_PREAMBLE_US;
         }
-        PulseCnt++;
+        first = 1;
     }
 
-    if (42 == PulseCnt) {
-        /* read success */
-        gpio_pin_interrupt_configure(dev, pin, GPIO_INT_DISABLE);
-        k_sem_give(&DhtReadDone);
+    /* DHT21 = AM2301 sends 64 bit, only first 40bis include data */
+    if (cnt < first + 1 + DHT2X_FRAME_BITS) {
+        return (-EAGAIN);
     }
 
-    PulseStartUs = us_now;
+    *frame = 0;
+    for (uint32_t i = first; i < first + DHT2X_FRAME_BITS; i++) {
+        uint32_t period = edge_us[i + 1] - edge_us[i];
+        *frame = (*frame << 1) | ((period > info->threshold_us) ? 1 : 0);
+    }
+
+    return (0);
 }
 
-int dht2x_init(const struct gpio_dt_spec *dhtx_spec) {
-    if (!device_is_ready(dhtx_spec->port)) {
-        LOG_ERR("Dht2x gpio not ready");
-        return -EIO;
+int dht2x_decode(uint64_t frame, int16_t *temp, int16_t *rh) {
+    uint8_t *buf = (uint8_t *)&frame;
+
+    /* verify checksum */
+    if (((buf[4] + buf[3] + buf[2] + buf[1]) & 0xFF) != buf[0] || 0 == buf[0]) {
+        LOG_ERR("Invalid checksum in fetched sample");
+        return (-ENOTSUP);
+    }
+
+    *rh = (frame >> 24) & 0xFFFF;
+    *temp = (frame >> 8) & 0xFFFF;
+
+    if (*temp & (1 << 15)) {
+        *temp &= ~(1 << 15);
+        *temp = -*temp;
     }
 
-    return gpio_pin_configure_dt(dhtx_spec, GPIO_OUTPUT_INACTIVE);
+    return (0);
 }
 
-int dht2x_read(const struct gpio_dt_spec *dhtx_spec, int16_t *temp,
-               int16_t *rh) {
+static int dht2x_read(const struct device *dev) {
+    const struct dht2x_config *cfg = dev->config;
+    struct dht2x_data *data = dev->data;
     int ret = 0;
-    LOG_DBG("%s", __FUNCTION__);
+    int frame_rc = 0;
+    uint32_t start_cyc = k_cycle_get_32();
+    uint32_t release_cyc = 0;
+    uint32_t edge_us[DHT2X_EDGES_MAX];
+    uint32_t cnt = 0;
+    uint64_t frame = 0;
+    struct dht2x_frame_info info = {0};
+    LOG_DBG("%s %s", __FUNCTION__, dev->name);
 
-    k_sem_take(&DhtReadDone, K_NO_WAIT);
-    PulseCnt = 0;
-    ReadData = 0;
+    k_sem_take(&data->read_done, K_NO_WAIT);
+    data->edge_cnt = 0;
 
-    gpio_pin_configure_dt(dhtx_spec, GPIO_OUTPUT_INACTIVE);
+    gpio_pin_configure_dt(&cfg->dio, GPIO_OUTPUT_INACTIVE);
 
     /* assert to send start signal */
-    gpio_pin_set_dt(dhtx_spec, true);
+    gpio_pin_set_dt(&cfg->dio, true);
 
     k_sleep(K_MSEC(18));
 
-    gpio_pin_set_dt(dhtx_spec, false);
-    PulseStartUs = dht2x_us_now();
+    gpio_pin_set_dt(&cfg->dio, false);
+    release_cyc = k_cycle_get_32();
+
+    gpio_pin_configure_dt(&cfg->dio, GPIO_INPUT);
+    gpio_pin_interrupt_configure_dt(&cfg->dio, GPIO_INT_EDGE_FALLING);
 
-    gpio_pin_configure_dt(dhtx_spec, GPIO_INPUT);
-    gpio_pin_interrupt_configure_dt(dhtx_spec, GPIO_INT_EDGE_FALLING);
-    gpio_init_callback(&IrqCb, gpio_callback, BIT(dhtx_spec->pin));
-    gpio_add_callback_dt(dhtx_spec, &IrqCb);
+    /* frame with missed first edge never reaches DHT2X_EDGES_MAX, timeout
+     * is expected then and the frame is decoded from edges received */
+    k_sem_take(&data->read_done, K_MSEC(cfg->frame_timeout_ms));
+    gpio_pin_interrupt_configure_dt(&cfg->dio, GPIO_INT_DISABLE);
+
+    cnt = data->edge_cnt;
+    for (uint32_t i = 0; i < cnt; i++) {
+        edge_us[i] = k_cyc_to_us_floor32(data->edges[i] - release_cyc);
+    }
+
+    ret = dht2x_frame_decode(edge_us, cnt, &frame, &info);
+    frame_rc = ret;
 
-    ret = k_sem_take(&DhtReadDone, K_MSEC(50));
     if (0 != ret) {
-        LOG_ERR("Read failed, PulseCnt %d", PulseCnt);
+        LOG_ERR("%s read failed, EdgeCnt %u", dev->name, cnt);
         ret = -EIO;
         goto read_done;
-    } else {
-        LOG_DBG("Read done, PulseCnt %d, LastElapsed %u, ReadData %010llX",
-                PulseCnt, LastElapsed, ReadData);
     }
+    LOG_DBG("Read done, EdgeCnt %u, threshold %u, frame %010llX", cnt,
+            info.threshold_us, frame);
 
-    uint8_t *buf = (uint8_t *)&ReadData;
+    ret = dht2x_decode(frame, &data->temp, &data->rh);
 
-    /* verify checksum */
-    if (((buf[4] + buf[3] + buf[2] + buf[1]) & 0xFF) != buf[0] || 0 == buf[0]) {
-        LOG_ERR("Invalid checksum in fetched sample");
-        ret = -ENOTSUP;
-        goto read_done;
-    } else {
-        LOG_DBG("Checksum valid");
-    }
+read_done:
+    gpio_pin_configure_dt(&cfg->dio, GPIO_OUTPUT_INACTIVE);
 
-    *rh = (ReadData >> 24) & 0xFFFF;
-    *temp = (ReadData >> 8) & 0xFFFF;
+    uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+    dht2x_stats_update(data, frame_rc, ret, edge_us, cnt, &info, latency_us);
+    return (ret);
+}
 
-    if (*temp & (1 << 15)) {
-        *temp &= ~(1 << 15);
-        *temp = -*temp;
+static int dht2x_sample_fetch(const struct device *dev,
+                              enum sensor_channel chan) {
+    struct dht2x_data *data = dev->data;
+    int ret = 0;
+
+    if ((SENSOR_CHAN_ALL != chan) && (SENSOR_CHAN_AMBIENT_TEMP != chan) &&
+        (SENSOR_CHAN_HUMIDITY != chan)) {
+        return (-ENOTSUP);
     }
 
-read_done:
-    gpio_pin_configure_dt(dhtx_spec, GPIO_OUTPUT_INACTIVE);
+    k_mutex_lock(&data->lock, K_FOREVER);
+    ret = dht2x_read(dev);
+    k_mutex_unlock(&data->lock);
     return (ret);
 }
 
+static int dht2x_channel_get(const struct device *dev,
+                             enum sensor_channel chan,
+                             struct sensor_value *val) {
+    struct dht2x_data *data = dev->data;
+    int16_t raw = 0;
+
+    switch (chan) {
+        case SENSOR_CHAN_AMBIENT_TEMP: {
+            raw = data->temp;
+            break;
+        }
+        case SENSOR_CHAN_HUMIDITY: {
+            raw = data->rh;
+            break;
+        }
+        default: {
+            return (-ENOTSUP);
+        }
+    }
+
+    /* 0.1 unit, sign is kept in both parts */
+    val->val1 = raw / 10;
+    val->val2 = (raw % 10) * 100000;
+    return (0);
+}
+
+static const struct sensor_driver_api Dht2xApi = {
+    .sample_fetch = dht2x_sample_fetch,
+    .channel_get = dht2x_channel_get,
+};
+
+static int dht2x_init(const struct device *dev) {
+    const struct dht2x_config *cfg = dev->config;
+    struct dht2x_data *data = dev->data;
+    int ret = 0;
+
+    if (!gpio_is_ready_dt(&cfg->dio)) {
+        LOG_ERR("%s gpio not ready", dev->name);
+        return -ENODEV;
+    }
+
+    data->dev = dev;
+    k_sem_init(&data->read_done, 0, 1);
+    k_mutex_init(&data->lock);
+
+    ret = gpio_pin_configure_dt(&cfg->dio, GPIO_OUTPUT_INACTIVE);
+    if (0 != ret) {
+        return (ret);
+    }
+
+    /* callback stays registered, edges are enabled only during read */
+    gpio_init_callback(&data->irq_cb, gpio_callback, BIT(cfg->dio.pin));
+    return gpio_add_callback_dt(&cfg->dio, &data->irq_cb);
+}
+
+#define DHT2X_DEFINE(inst)                                                     \
+    static struct dht2x_data Dht2xData##inst;                                  \
+    static const struct dht2x_config Dht2xConfig##inst = {                     \
+        .dio = GPIO_DT_SPEC_INST_GET(inst, dio_gpios),                         \
+        .frame_timeout_ms = DT_INST_PROP(inst, frame_timeout_ms),              \
+    };                                                                         \
+    SENSOR_DEVICE_DT_INST_DEFINE(inst, dht2x_init, NULL, &Dht2xData##inst,     \
+                                 &Dht2xConfig##inst, POST_KERNEL,              \
+                                 CONFIG_SENSOR_INIT_PRIORITY, &Dht2xApi);
+
+DT_INST_FOREACH_STATUS_OKAY(DHT2X_DEFINE)
+
 /* ---------------------------------------------------------------------------
  * end of file
  * --------------------------------------------------------------------------*/
\ No newline at end of file
@@ -13,11 +13,12 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/net/mqtt.h>
+#include <zephyr/net/socket.h>
 #include <zephyr/net/socketutils.h>
 #include <zephyr/sys/reboot.h>
 
 #include "nvs_data.h"
-#include "wdg.h"
+#include "task_sched.h"
 
 LOG_MODULE_REGISTER(MQTT, LOG_LEVEL_DBG);
 
@@ -36,16 +37,30 @@ typedef enum worker_state {
     DISCONNECTED
 } worker_state_t;
 
+/* Sent message waiting for PUBACK, payload is kept for retransmission */
+struct mqtt_worker_inflight {
+    struct mqtt_worker_pub_req req;
+    uint16_t message_id; /* 0 - slot free */
+    uint8_t retries;
+    int64_t deadline;
+    uint32_t len;
+    uint8_t *payload; /* allocated from PayloadHeap, exact length */
+};
+
 static void mqtt_evt_handler(struct mqtt_client *const client,
                              const struct mqtt_evt *evt);
 static void mqtt_worker_disconnect(int32_t reason);
 
-static int32_t wait_for_input(int32_t timeout);
+static int32_t wait_for_input(int32_t timeout, bool wakeable);
 static int32_t dns_resolve(void);
 static int32_t connect_to_broker(void);
 static int32_t input_handle(void);
 static int32_t mqtt_worker_subscribe(void);
 
+static int64_t mqtt_worker_keepalive_task(int64_t due_ms);
+static void mqtt_worker_pub_process(void);
+static void mqtt_worker_pub_done(struct mqtt_worker_inflight *slot,
+                                 int result);
 static void mqtt_proc(void *, void *, void *);
 static void subscribe_proc(void *, void *, void *);
 
@@ -69,6 +84,27 @@ static enum mqtt_evt_type LastEvt = 0;
 
 static worker_state_t StateMachine = DNS_RESOLVE;
 static char PublishBuffer[MQTT_WORKER_MAX_PUBLISH_LEN];
+static uint32_t PublishLen = 0;
+static int PublishResult = 0;
+static uint32_t PublishGen = 0; /* blocking publish being waited for */
+
+/* The last slot is reserved for urgent messages, so they are never stuck
+ * behind regular traffic waiting for PUBACK */
+#define MQTT_WORKER_SLOTS (CONFIG_MQTT_WORKER_INFLIGHT_MAX + 1)
+
+/* Heap bookkeeping per allocation, rounded up generously */
+#define MQTT_WORKER_HEAP_OVERHEAD (64)
+
+BUILD_ASSERT(CONFIG_MQTT_WORKER_PAYLOAD_HEAP_SIZE >=
+                 MQTT_WORKER_SLOTS *
+                     (MQTT_WORKER_MAX_PUBLISH_LEN + MQTT_WORKER_HEAP_OVERHEAD),
+             "Payload heap can not hold all in flight messages");
+
+static struct mqtt_worker_inflight InFlight[MQTT_WORKER_SLOTS];
+static uint16_t NextMessageId = 1;
+
+/* Urgent submitter writes into [1] to wake up worker polling [0] */
+static int WakeFds[2] = {-1, -1};
 
 static bool Connected = false;
 static bool DisconnectReqExternal = false;
@@ -87,11 +123,19 @@ K_THREAD_DEFINE(SubsTid, SUBSCRIBE_STACK_SIZE, subscribe_proc, NULL, NULL, NULL,
                 SUBSCRIBE_PRIORITY, 0, 0);
 
 K_SEM_DEFINE(PublishAckSem, 0, 1);
+K_MUTEX_DEFINE(PublishLock);    /* serializes blocking publish callers */
+K_MUTEX_DEFINE(PublishBufLock); /* PublishBuffer, PublishLen, PublishGen */
+K_HEAP_DEFINE(PayloadHeap, CONFIG_MQTT_WORKER_PAYLOAD_HEAP_SIZE);
 K_SEM_DEFINE(ConectedAckSem, 0, 1);
 K_SEM_DEFINE(WorkerProcStartSem, 0, 1);
 K_MSGQ_DEFINE(SubsQueue, sizeof(subs_data_t *), 4, 4);
+K_MSGQ_DEFINE(PubQueue, sizeof(struct mqtt_worker_pub_req),
+              CONFIG_MQTT_WORKER_PUB_QUEUE_LEN, 4);
+K_MSGQ_DEFINE(UrgentQueue, sizeof(struct mqtt_worker_pub_req),
+              CONFIG_MQTT_WORKER_URGENT_QUEUE_LEN, 4);
 K_MEM_SLAB_DEFINE_STATIC(SubsQueueSlab, sizeof(subs_data_t), 4, 4);
 
+static struct task_sched_task KeepaliveTask;
 static int64_t LastKeepaliveResp = 0;
 static uint32_t PingPeriodSec = 0;
 static uint32_t MaxPingNoAnsMins = 0;
@@ -104,19 +148,60 @@ static uint32_t MaxPingNoAnsMins = 0;
  */
 extern void net_on_disconnect_reqister(void (*disco_cb)(int reason));
 
-void mqtt_worker_keepalive_test(void) {
-    /* wait 2 hours for mqtt connection, samples has to be stored in nvs */
+/**
+ * @brief Keepalive task, runs when the last keepalive response becomes older
+ * than CONFIG_MQTT_KEEPALIVE_TIMEOUT_MINS, if no response came in the meantime
+ * reboot device.
+ */
+static int64_t mqtt_worker_keepalive_task(int64_t due_ms) {
+    /* samples are kept in sample log until broker is reachable again */
     int64_t mqtt_alive_timeout = MaxPingNoAnsMins * 60 * 1000;
-    if (k_uptime_get() > LastKeepaliveResp + mqtt_alive_timeout) {
+    int64_t deadline = LastKeepaliveResp + mqtt_alive_timeout;
+    if (k_uptime_get() > deadline) {
         sys_reboot(SYS_REBOOT_COLD);
     }
+    return (deadline + 1);
+}
+
+static int mqtt_worker_sync_encode(uint8_t *dst, size_t size,
+                                   void *user_data) {
+    int ret = -ECANCELED;
+
+    /* request the caller gave up waiting for must not pick up payload of
+     * the next blocking publish */
+    k_mutex_lock(&PublishBufLock, K_FOREVER);
+    if ((uint32_t)(uintptr_t)user_data == PublishGen) {
+        if (NULL != dst) {
+            memcpy(dst, PublishBuffer, MIN(PublishLen, size));
+        }
+        ret = PublishLen;
+    }
+    k_mutex_unlock(&PublishBufLock);
+
+    return (ret);
+}
+
+static void mqtt_worker_sync_done(int result, void *user_data) {
+    k_mutex_lock(&PublishBufLock, K_FOREVER);
+    /* late result of publish which caller gave up waiting for */
+    if ((uint32_t)(uintptr_t)user_data == PublishGen) {
+        PublishResult = result;
+        k_sem_give(&PublishAckSem);
+    }
+    k_mutex_unlock(&PublishBufLock);
 }
 
 int mqtt_worker_publish_qos1(const char *topic, const char *fmt, ...) {
     int ret = 0;
+    struct mqtt_worker_pub_req req = {
+        .topic = topic,
+        .encode = mqtt_worker_sync_encode,
+        .done = mqtt_worker_sync_done,
+    };
 
     va_list args;
     va_start(args, fmt);
+    k_mutex_lock(&PublishLock, K_FOREVER);
 
     if (!Connected || DisconnectReqExternal) {
         LOG_WRN("Cannot publish, client not connected");
@@ -124,35 +209,229 @@ int mqtt_worker_publish_qos1(const char *topic, const char *fmt, ...) {
         goto failed_done;
     }
 
-    uint32_t len =
-        vsnprintf(PublishBuffer, MQTT_WORKER_MAX_PUBLISH_LEN, fmt, args);
-
-    PubData.message.payload.len = len;
-    PubData.message.topic.topic.utf8 = (uint8_t *)topic;
-    PubData.message.topic.topic.size = strlen((const char *)topic);
-    PubData.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE;
-    PubData.message_id += 1U;
-
-    struct mqtt_client *client = &ClientCtx;
+    k_mutex_lock(&PublishBufLock, K_FOREVER);
+    ret = vsnprintf(PublishBuffer, MQTT_WORKER_MAX_PUBLISH_LEN, fmt, args);
+    PublishLen = MIN(ret, MQTT_WORKER_MAX_PUBLISH_LEN - 1);
+    req.user_data = (void *)(uintptr_t)++PublishGen;
+    k_sem_reset(&PublishAckSem);
+    k_mutex_unlock(&PublishBufLock);
 
-    k_sem_take(&PublishAckSem, K_NO_WAIT);
-    ret = mqtt_publish(client, &PubData);
-    if (ret != 0) {
-        LOG_ERR("could not publish, err %d", ret);
+    ret = mqtt_worker_publish_submit(&req);
+    if (0 != ret) {
         goto failed_done;
     }
 
-    ret =
-        k_sem_take(&PublishAckSem, K_SECONDS(MQTT_WORKER_PUBLISH_ACK_TIMEOUT));
-    if (ret != 0) {
-        LOG_ERR("publish ack timeout");
+    /* worker completes every request, acked, timed out or dropped, within
+     * all retransmissions */
+    ret = -ETIMEDOUT;
+    if (0 == k_sem_take(&PublishAckSem,
+                        K_MSEC(MQTT_WORKER_PUBLISH_SYNC_TIMEOUT_MS))) {
+        ret = PublishResult;
+    }
+    if (-ETIMEDOUT == ret) {
+        /* request still queued or in flight is cancelled on encode or its
+         * result ignored */
+        LOG_ERR("Publish not completed in time");
+        k_mutex_lock(&PublishBufLock, K_FOREVER);
+        PublishGen++;
+        k_mutex_unlock(&PublishBufLock);
     }
 
 failed_done:
+    k_mutex_unlock(&PublishLock);
     va_end(args);
     return (ret);
 }
 
+int mqtt_worker_publish_submit(const struct mqtt_worker_pub_req *req) {
+    int ret = k_msgq_put(&PubQueue, req, K_NO_WAIT);
+    if (0 != ret) {
+        LOG_WRN("Publish queue full");
+        ret = -ENOBUFS;
+    }
+    return (ret);
+}
+
+int mqtt_worker_publish_urgent(const struct mqtt_worker_pub_req *req) {
+    const uint8_t wake = 1;
+    int ret = k_msgq_put(&UrgentQueue, req, K_NO_WAIT);
+    if (0 != ret) {
+        LOG_WRN("Urgent queue full");
+        ret = -ENOBUFS;
+        goto urgent_done;
+    }
+
+    /* full pair means worker has not drained previous wake up yet */
+    if (0 <= WakeFds[1]) {
+        (void)zsock_send(WakeFds[1], &wake, sizeof(wake), ZSOCK_MSG_DONTWAIT);
+    }
+
+urgent_done:
+    return (ret);
+}
+
+bool mqtt_worker_connected(void) {
+    return (Connected && !DisconnectReqExternal);
+}
+
+/**
+ * @brief Complete in flight request, free its slot and report result to
+ * submitter.
+ */
+static void mqtt_worker_pub_done(struct mqtt_worker_inflight *slot,
+                                 int result) {
+    struct mqtt_worker_pub_req req = slot->req;
+
+    k_heap_free(&PayloadHeap, slot->payload);
+    slot->payload = NULL;
+    slot->message_id = 0;
+    if (NULL != req.done) {
+        req.done(result, req.user_data);
+    }
+}
+
+static uint16_t mqtt_worker_message_id_next(void) {
+    for (;;) {
+        uint16_t id = NextMessageId++;
+        bool used = (0 == id); /* 0 is not valid packet identifier */
+        for (int i = 0; i < MQTT_WORKER_SLOTS; i++) {
+            used |= (InFlight[i].message_id == id);
+        }
+        if (!used) {
+            return (id);
+        }
+    }
+}
+
+static int mqtt_worker_pub_send(struct mqtt_worker_inflight *slot, bool dup) {
+    struct mqtt_publish_param param = PubData;
+
+    param.message.payload.data = slot->payload;
+    param.message.payload.len = slot->len;
+    param.message.topic.topic.utf8 = (uint8_t *)slot->req.topic;
+    param.message.topic.topic.size = strlen(slot->req.topic);
+    param.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE;
+    param.message_id = slot->message_id;
+    param.dup_flag = dup ? 1U : 0U;
+
+    slot->deadline =
+        k_uptime_get() + MQTT_WORKER_PUBLISH_ACK_TIMEOUT * MSEC_PER_SEC;
+    return (mqtt_publish(&ClientCtx, &param));
+}
+
+/**
+ * @brief Take the oldest request of queue into free slot, encode and send it.
+ *
+ * @return int -ENOMSG when queue is empty, 0 otherwise, failed request is
+ * completed and slot is free again
+ */
+static int mqtt_worker_pub_start(struct mqtt_worker_inflight *slot,
+                                 struct k_msgq *queue) {
+    int ret = 0;
+
+    if (0 != k_msgq_get(queue, &slot->req, K_NO_WAIT)) {
+        return (-ENOMSG);
+    }
+
+    /* the first pass gives exact length, the second one encodes straight
+     * into buffer handed over to mqtt_publish() */
+    ret = slot->req.encode(NULL, MQTT_WORKER_MAX_PUBLISH_LEN,
+                           slot->req.user_data);
+    if (0 <= ret) {
+        slot->len = ret;
+        slot->payload = k_heap_alloc(&PayloadHeap, slot->len + 1, K_NO_WAIT);
+        ret = (NULL == slot->payload) ? -ENOMEM : 0;
+    }
+    if (0 == ret) {
+        ret = slot->req.encode(slot->payload, slot->len + 1,
+                               slot->req.user_data);
+        ret = ((uint32_t)ret == slot->len) ? 0 : -EIO;
+    }
+    if (0 != ret) {
+        LOG_ERR("could not encode payload, err %d", ret);
+        mqtt_worker_pub_done(slot, ret);
+        return (0);
+    }
+
+    slot->retries = 0;
+    slot->message_id = mqtt_worker_message_id_next();
+    ret = mqtt_worker_pub_send(slot, false);
+    if (0 != ret) {
+        LOG_ERR("could not publish, err %d", ret);
+        mqtt_worker_pub_done(slot, ret);
+    }
+    return (0);
+}
+
+/**
+ * @brief Drive publish queue, called from worker thread only. Retransmit
+ * messages not acked in time, up to CONFIG_MQTT_WORKER_PUBLISH_RETRIES times,
+ * and send queued requests, urgent ones first, while there is free in flight
+ * slot. Without connection all requests are completed with -ENETUNREACH.
+ */
+static void mqtt_worker_pub_process(void) {
+    struct mqtt_worker_pub_req req = {0};
+    struct mqtt_worker_inflight *slot = NULL;
+    int ret = 0;
+
+    if (!Connected || DisconnectReqExternal) {
+        for (int i = 0; i < MQTT_WORKER_SLOTS; i++) {
+            if (0 != InFlight[i].message_id) {
+                mqtt_worker_pub_done(&InFlight[i], -ENETUNREACH);
+            }
+        }
+        while ((0 == k_msgq_get(&UrgentQueue, &req, K_NO_WAIT)) ||
+               (0 == k_msgq_get(&PubQueue, &req, K_NO_WAIT))) {
+            if (NULL != req.done) {
+                req.done(-ENETUNREACH, req.user_data);
+            }
+        }
+        goto process_done;
+    }
+
+    int64_t uptime_ms = k_uptime_get();
+    for (int i = 0; i < MQTT_WORKER_SLOTS; i++) {
+        slot = &InFlight[i];
+        if ((0 == slot->message_id) || (uptime_ms < slot->deadline)) {
+            continue;
+        }
+
+        if (CONFIG_MQTT_WORKER_PUBLISH_RETRIES <= slot->retries) {
+            LOG_ERR("publish ack timeout, id %u", slot->message_id);
+            mqtt_worker_pub_done(slot, -ETIMEDOUT);
+            continue;
+        }
+
+        slot->retries++;
+        LOG_WRN("publish retransmit, id %u", slot->message_id);
+        ret = mqtt_worker_pub_send(slot, true);
+        if (0 != ret) {
+            LOG_ERR("could not publish, err %d", ret);
+            mqtt_worker_pub_done(slot, ret);
+        }
+    }
+
+    /* urgent requests take any free slot first, regular ones never take
+     * the reserved slot */
+    for (int i = 0; i < MQTT_WORKER_SLOTS; i++) {
+        slot = &InFlight[i];
+        if ((0 == slot->message_id) &&
+            (-ENOMSG == mqtt_worker_pub_start(slot, &UrgentQueue))) {
+            break;
+        }
+    }
+    for (int i = 0; i < CONFIG_MQTT_WORKER_INFLIGHT_MAX; i++) {
+        slot = &InFlight[i];
+        if ((0 == slot->message_id) &&
+            (-ENOMSG == mqtt_worker_pub_start(slot, &PubQueue))) {
+            break;
+        }
+    }
+
+process_done:
+    return;
+}
+
 void mqtt_worker_init(const char *hostname, int32_t port, uint32_t ping_period,
                       uint32_t max_ping_no_answer,
                       struct mqtt_subscription_list *subs, subs_cb_t subs_cb) {
@@ -183,23 +462,26 @@ void mqtt_worker_init(const char *hostname, int32_t port, uint32_t ping_period,
     client->tx_buf = TxBuffer;
     client->tx_buf_size = sizeof(TxBuffer);
 
-    PubData.message.payload.data = (uint8_t *)PublishBuffer;
-    PubData.message_id = 1U;
     PubData.dup_flag = 0U;
     PubData.retain_flag = 1U;
 
+    int ret = zsock_socketpair(AF_UNIX, SOCK_STREAM, 0, WakeFds);
+    __ASSERT((0 == ret), "Worker wake up socketpair failed");
+
     net_on_disconnect_reqister(mqtt_worker_disconnect);
     k_sem_give(&WorkerProcStartSem);
 
     int32_t sec_cnt = 0;
     for (sec_cnt = 0; sec_cnt < CONFIG_MQTT_FIRST_CONN_TIMEOUT_SEC; sec_cnt++) {
-        wdg_feed();
         if (0 == k_sem_take(&ConectedAckSem, K_SECONDS(1))) {
             break;
         }
     }
     __ASSERT((CONFIG_MQTT_FIRST_CONN_TIMEOUT_SEC != sec_cnt),
              "Mqtt connection timeout");
+
+    task_sched_start(&KeepaliveTask, "mqtt_keepalive",
+                     mqtt_worker_keepalive_task, k_uptime_get());
 }
 
 static void subscribe_proc(void *arg1, void *arg2, void *arg3) {
@@ -222,6 +504,7 @@ static void mqtt_proc(void *arg1, void *arg2, void *arg3) {
 
     k_sem_take(&WorkerProcStartSem, K_FOREVER);
     for (;;) {
+        mqtt_worker_pub_process();
         switch (StateMachine) {
             case DNS_RESOLVE: {
                 LOG_INF("DNS_RESOLVE");
@@ -307,7 +590,7 @@ static int mqtt_worker_subscribe(void) {
 
     while (true) {
         LastEvt = 0xFF;
-        ret = wait_for_input(4000);
+        ret = wait_for_input(4000, false);
         if (0 < ret) {
             mqtt_input(client);
             if (LastEvt != MQTT_EVT_SUBACK && LastEvt != 0xFF) {
@@ -328,32 +611,40 @@ failed_done:
     return (ret);
 }
 
-static int wait_for_input(int32_t timeout) {
+/**
+ * @brief Wait for input from broker. Wakeable wait returns early, with no
+ * input, when urgent publish request is queued.
+ */
+static int wait_for_input(int32_t timeout, bool wakeable) {
 #if defined(CONFIG_MQTT_LIB_TLS)
-    struct zsock_pollfd fds[1] = {
-        [0] =
-            {
-                .fd = ClientCtx.transport.tls.sock,
-                .events = ZSOCK_POLLIN,
-                .revents = 0,
-            },
-    };
+    int sock = ClientCtx.transport.tls.sock;
 #else
-    struct zsock_pollfd fds[1] = {
-        [0] =
-            {
-                .fd = ClientCtx.transport.tcp.sock,
-                .events = ZSOCK_POLLIN,
-                .revents = 0,
-            },
-    };
+    int sock = ClientCtx.transport.tcp.sock;
 #endif
+    struct zsock_pollfd fds[2] = {
+        [0] = {.fd = sock, .events = ZSOCK_POLLIN, .revents = 0},
+        /* negative fd is ignored by poll */
+        [1] = {.fd = wakeable ? WakeFds[0] : -1,
+               .events = ZSOCK_POLLIN,
+               .revents = 0},
+    };
+    uint8_t wake[8];
 
-    int ret = zsock_poll(fds, 1, timeout);
+    int ret = zsock_poll(fds, ARRAY_SIZE(fds), timeout);
     if (0 > ret) {
         LOG_ERR("zsock_poll event err %d", ret);
+        goto wait_done;
     }
 
+    if (0 != (fds[1].revents & ZSOCK_POLLIN)) {
+        while (0 < zsock_recv(WakeFds[0], wake, sizeof(wake),
+                              ZSOCK_MSG_DONTWAIT)) {
+            ; /* wake ups are only counted by queue itself */
+        }
+    }
+    ret = (0 != fds[0].revents) ? 1 : 0;
+
+wait_done:
     return (ret);
 }
 
@@ -370,7 +661,7 @@ static int connect_to_broker(void) {
         goto failed_done;
     }
 
-    ret = wait_for_input(2000);
+    ret = wait_for_input(2000, false);
     if (0 < ret) {
         mqtt_input(client);
     }
@@ -395,7 +686,9 @@ static int input_handle(void) {
     /* idle and process messages */
     int64_t uptime_ms = k_uptime_get();
     if (uptime_ms < next_alive) {
-        ret = wait_for_input(1 * MSEC_PER_SEC);
+        /* urgent request wakes worker up, it is sent without waiting for
+         * the rest of idle time */
+        ret = wait_for_input(1 * MSEC_PER_SEC, true);
         if (0 < ret) {
             mqtt_input(client);
         }
@@ -585,7 +878,18 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
                 LOG_ERR("PUBACK error %d", evt->result);
             } else {
                 LOG_INF("PUBACK packet id: %u", evt->param.puback.message_id);
-                k_sem_give(&PublishAckSem);
+                struct mqtt_worker_inflight *slot = NULL;
+                for (int i = 0; i < MQTT_WORKER_SLOTS; i++) {
+                    if (InFlight[i].message_id ==
+                        evt->param.puback.message_id) {
+                        slot = &InFlight[i];
+                    }
+                }
+                if (NULL != slot) {
+                    mqtt_worker_pub_done(slot, 0);
+                } else {
+                    LOG_WRN("PUBACK for unknown packet id");
+                }
             }
             break;
         }
@@ -268,6 +268,113 @@ int nvs_data_wlab_pub_period_set(uint32_t *pub_period) {
     return (ret);
 }
 
+void nvs_data_wlab_payload_fmt_get(uint32_t *payload_fmt) {
+    __ASSERT((payload_fmt != NULL), "Null pointer passed");
+    size_t wlab_payload_fmt_len = sizeof(uint32_t);
+
+    int ret = nvs_read(&Fs, NVS_ID_WLAB_PAYLOAD_FMT, payload_fmt,
+                       wlab_payload_fmt_len);
+    if (ret > 0) {
+        LOG_DBG("wlab payload fmt: %u", *payload_fmt);
+    } else {
+        LOG_WRN("No wlab payload fmt found, restore default");
+        memset(payload_fmt, 0x00, wlab_payload_fmt_len);
+        if (wlab_payload_fmt_len == nvs_write(&Fs, NVS_ID_WLAB_PAYLOAD_FMT,
+                                              payload_fmt,
+                                              wlab_payload_fmt_len)) {
+            LOG_DBG("Wlab payload fmt clear success");
+        } else {
+            LOG_ERR("Wlab payload fmt clear failed");
+        }
+    }
+}
+
+int nvs_data_wlab_payload_fmt_set(uint32_t *payload_fmt) {
+    __ASSERT((payload_fmt != NULL), "Null pointer passed");
+    size_t wlab_payload_fmt_len = sizeof(uint32_t);
+
+    int ret = 0;
+    if (wlab_payload_fmt_len == nvs_write(&Fs, NVS_ID_WLAB_PAYLOAD_FMT,
+                                          payload_fmt, wlab_payload_fmt_len)) {
+        LOG_DBG("Wlab payload fmt set success");
+    } else {
+        LOG_ERR("Wlab payload fmt set failed");
+        ret = -EIO;
+    }
+    return (ret);
+}
+
+void nvs_data_sntp_servers_get(char *servers) {
+    __ASSERT((servers != NULL), "Null pointer passed");
+    int ret = nvs_read(&Fs, NVS_ID_SNTP_SERVERS, servers,
+                       CONFIG_SNTP_SERVERS_MAX_LEN);
+    if (ret > 0) {
+        servers[CONFIG_SNTP_SERVERS_MAX_LEN - 1] = '\0';
+        LOG_DBG("sntp servers: <%s>", servers);
+    } else {
+        LOG_WRN("No sntp servers found, restore default");
+        strncpy(servers, CONFIG_SNTP_SERVERS_DEFAULT,
+                CONFIG_SNTP_SERVERS_MAX_LEN);
+        servers[CONFIG_SNTP_SERVERS_MAX_LEN - 1] = '\0';
+        if (CONFIG_SNTP_SERVERS_MAX_LEN ==
+            nvs_write(&Fs, NVS_ID_SNTP_SERVERS, servers,
+                      CONFIG_SNTP_SERVERS_MAX_LEN)) {
+            LOG_DBG("Sntp servers clear success");
+        } else {
+            LOG_ERR("Sntp servers clear failed");
+        }
+    }
+}
+
+int nvs_data_sntp_servers_set(char *servers) {
+    __ASSERT((servers != NULL), "Null pointer passed");
+    int ret = 0;
+    if (CONFIG_SNTP_SERVERS_MAX_LEN == nvs_write(&Fs, NVS_ID_SNTP_SERVERS,
+                                                 servers,
+                                                 CONFIG_SNTP_SERVERS_MAX_LEN)) {
+        LOG_DBG("Sntp servers set success");
+    } else {
+        LOG_ERR("Sntp servers set failed");
+        ret = -EIO;
+    }
+    return (ret);
+}
+
+void nvs_data_timestamp_checkpoint_get(int64_t *epoch_ms) {
+    __ASSERT((epoch_ms != NULL), "Null pointer passed");
+    size_t checkpoint_len = sizeof(int64_t);
+
+    int ret =
+        nvs_read(&Fs, NVS_ID_TIMESTAMP_CHECKPOINT, epoch_ms, checkpoint_len);
+    if (ret > 0) {
+        LOG_DBG("timestamp checkpoint: %lld", *epoch_ms);
+    } else {
+        LOG_WRN("No timestamp checkpoint found, restore default");
+        memset(epoch_ms, 0x00, checkpoint_len);
+        if (checkpoint_len == nvs_write(&Fs, NVS_ID_TIMESTAMP_CHECKPOINT,
+                                        epoch_ms, checkpoint_len)) {
+            LOG_DBG("Timestamp checkpoint clear success");
+        } else {
+            LOG_ERR("Timestamp checkpoint clear failed");
+        }
+    }
+}
+
+int nvs_data_timestamp_checkpoint_set(int64_t *epoch_ms) {
+    __ASSERT((epoch_ms != NULL), "Null pointer passed");
+    size_t checkpoint_len = sizeof(int64_t);
+
+    int ret = 0;
+    if (checkpoint_len == nvs_write(&Fs, NVS_ID_TIMESTAMP_CHECKPOINT,
+                                    epoch_ms, checkpoint_len)) {
+        LOG_DBG("Timestamp checkpoint set success");
+    } else {
+        LOG_ERR("Timestamp checkpoint set failed");
+        ret = -EIO;
+    }
+    return (ret);
+}
+
 /* ---------------------------------------------------------------------------
  * end of file
  * --------------------------------------------------------------------------*/
\ No newline at end of file
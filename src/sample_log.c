@@ -0,0 +1,192 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sample_log.c
+ * --------------------------------------------------------------------------*/
+#include "sample_log.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+
+LOG_MODULE_REGISTER(SLOG, LOG_LEVEL_DBG);
+
+/* Every record is kept under its own nvs id, id = 1 + (seq % capacity). The
+ * sequence number is stored together with data, so head and tail can be
+ * recovered after reset without any extra metadata writes. */
+struct sample_log_entry {
+    uint32_t seq;
+    uint8_t data[SAMPLE_LOG_RECORD_MAX_LEN];
+};
+
+#define SAMPLE_LOG_ENTRY_HDR_LEN (offsetof(struct sample_log_entry, data))
+
+static struct nvs_fs Fs = {0};
+static K_MUTEX_DEFINE(LogLock);
+
+static uint32_t HeadSeq = 0; /* seq of next record to append */
+static uint32_t TailSeq = 0; /* seq of the oldest record */
+static uint32_t Lost = 0;    /* records overwritten since init */
+
+static uint16_t sample_log_id(uint32_t seq) {
+    return (1 + (seq % CONFIG_SAMPLE_LOG_CAPACITY));
+}
+
+void sample_log_init(void) {
+    int ret = 0;
+    struct flash_pages_info info = {0};
+    struct sample_log_entry entry = {0};
+    bool found = false;
+    uint32_t newest = 0, oldest = 0;
+
+    Fs.flash_device = SAMPLE_LOG_PARTITION_DEVICE;
+    ret = device_is_ready(Fs.flash_device);
+    __ASSERT((ret != 0), "Flash not ready");
+
+    Fs.offset = SAMPLE_LOG_PARTITION_OFFSET;
+    ret = flash_get_page_info_by_offs(Fs.flash_device, Fs.offset, &info);
+    __ASSERT((0 == ret), "Unable to get page info err %d", ret);
+
+    Fs.sector_size = info.size;
+    Fs.sector_count = SAMPLE_LOG_PARTITION_SIZE / info.size;
+
+    ret = nvs_mount(&Fs);
+    __ASSERT((0 == ret), "Sample log mount failed");
+
+    for (uint32_t id = 1; id <= CONFIG_SAMPLE_LOG_CAPACITY; id++) {
+        ret = nvs_read(&Fs, id, &entry, SAMPLE_LOG_ENTRY_HDR_LEN);
+        if (ret < (int)SAMPLE_LOG_ENTRY_HDR_LEN) {
+            continue;
+        }
+
+        if (!found) {
+            newest = entry.seq;
+            oldest = entry.seq;
+            found = true;
+            continue;
+        }
+
+        /* sequence numbers may wrap, compare as distance */
+        if ((int32_t)(entry.seq - newest) > 0) {
+            newest = entry.seq;
+        }
+        if ((int32_t)(entry.seq - oldest) < 0) {
+            oldest = entry.seq;
+        }
+    }
+
+    if (found) {
+        TailSeq = oldest;
+        HeadSeq = newest + 1;
+    }
+
+    LOG_INF("Sample log capacity %u, pending records %u",
+            CONFIG_SAMPLE_LOG_CAPACITY, sample_log_count());
+}
+
+int sample_log_append(const void *record, size_t len) {
+    int ret = 0;
+    struct sample_log_entry entry = {0};
+
+    if (SAMPLE_LOG_RECORD_MAX_LEN < len) {
+        return (-EINVAL);
+    }
+
+    k_mutex_lock(&LogLock, K_FOREVER);
+
+    entry.seq = HeadSeq;
+    memcpy(entry.data, record, len);
+
+    size_t entry_len = SAMPLE_LOG_ENTRY_HDR_LEN + len;
+    ret = nvs_write(&Fs, sample_log_id(HeadSeq), &entry, entry_len);
+    if (0 > ret) {
+        LOG_ERR("Append record %u failed, err %d", HeadSeq, ret);
+        goto append_done;
+    }
+
+    HeadSeq++;
+    if (CONFIG_SAMPLE_LOG_CAPACITY < (HeadSeq - TailSeq)) {
+        /* the oldest record has been just overwritten */
+        LOG_WRN("Sample log full, record %u lost", TailSeq);
+        TailSeq++;
+        Lost++;
+    }
+    ret = 0;
+
+append_done:
+    k_mutex_unlock(&LogLock);
+    return (ret);
+}
+
+int sample_log_peek(uint32_t idx, void *record, size_t len) {
+    int ret = 0;
+    struct sample_log_entry entry = {0};
+
+    k_mutex_lock(&LogLock, K_FOREVER);
+
+    if (idx >= (HeadSeq - TailSeq)) {
+        ret = -ENOENT;
+        goto peek_done;
+    }
+
+    uint32_t seq = TailSeq + idx;
+    ret = nvs_read(&Fs, sample_log_id(seq), &entry, sizeof(entry));
+    if ((ret < (int)SAMPLE_LOG_ENTRY_HDR_LEN) || (entry.seq != seq)) {
+        LOG_ERR("Record %u corrupted, err %d", seq, ret);
+        ret = -EIO;
+        goto peek_done;
+    }
+
+    ret -= SAMPLE_LOG_ENTRY_HDR_LEN;
+    ret = MIN(ret, (int)len);
+    memcpy(record, entry.data, ret);
+
+peek_done:
+    k_mutex_unlock(&LogLock);
+    return (ret);
+}
+
+int sample_log_drop(uint32_t n) {
+    int ret = 0;
+
+    k_mutex_lock(&LogLock, K_FOREVER);
+
+    n = MIN(n, HeadSeq - TailSeq);
+    while (n--) {
+        ret = nvs_delete(&Fs, sample_log_id(TailSeq));
+        if (0 != ret) {
+            LOG_ERR("Drop record %u failed, err %d", TailSeq, ret);
+            break;
+        }
+        TailSeq++;
+    }
+
+    k_mutex_unlock(&LogLock);
+    return (ret);
+}
+
+uint32_t sample_log_count(void) {
+    k_mutex_lock(&LogLock, K_FOREVER);
+    uint32_t cnt = HeadSeq - TailSeq;
+    k_mutex_unlock(&LogLock);
+
+    return (cnt);
+}
+
+uint32_t sample_log_lost(void) {
+    k_mutex_lock(&LogLock, K_FOREVER);
+    uint32_t lost = Lost;
+    k_mutex_unlock(&LogLock);
+
+    return (lost);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
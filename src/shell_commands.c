@@ -3,12 +3,21 @@
  * ---------------------------------------------------------------------------
  *  Name: shell_commands.c
  * --------------------------------------------------------------------------*/
+#include <errno.h>
 #include <stdlib.h>
 #include <zephyr/kernel.h>
 #include <zephyr/shell/shell.h>
 #include <zephyr/sys/util.h>
 
+#include "dht2x.h"
 #include "nvs_data.h"
+#include "task_sched.h"
+#include "timestamp.h"
+#include "wlab.h"
+#include "wlab_acq.h"
+#include "wlab_alarm.h"
+#include "wlab_bench.h"
+#include "wlab_codec.h"
 
 // (WPA/WPA2 enabled)  $ wificonf <ssid> <passwd>
 // (open network)      $ wificonf <ssid>
@@ -109,6 +118,27 @@ static int cmd_wlab_name(const struct shell *shell, size_t argc, char *argv[]) {
     return (0);
 }
 
+// $ ntpconf <server>[,<server>...]
+static int cmd_ntp_config(const struct shell *shell, size_t argc,
+                          char *argv[]) {
+    if (argc != 2) {
+        shell_fprintf(shell, SHELL_NORMAL, "\tBad command usage!");
+        return (0);
+    }
+
+    char servers[CONFIG_SNTP_SERVERS_MAX_LEN];
+    memset(servers, 0x00, CONFIG_SNTP_SERVERS_MAX_LEN);
+    strncpy(servers, argv[1], CONFIG_SNTP_SERVERS_MAX_LEN - 1);
+    if (0 == nvs_data_sntp_servers_set(servers)) {
+        shell_fprintf(shell, SHELL_NORMAL, "sntp_servers: <%s>\n", servers);
+        shell_fprintf(shell, SHELL_NORMAL, "\tOK!\n");
+    } else {
+        shell_fprintf(shell, SHELL_NORMAL, "\tFailed!\n");
+    }
+
+    return (0);
+}
+
 // $ wlabpubp <publish_period_mins>
 static int cmd_wlab_publish_period(const struct shell *shell, size_t argc,
                                    char *argv[]) {
@@ -118,8 +148,13 @@ static int cmd_wlab_publish_period(const struct shell *shell, size_t argc,
     }
 
     uint32_t pub_period = strtoul(argv[1], NULL, 10);
+    if (0 == pub_period) {
+        shell_fprintf(shell, SHELL_NORMAL, "\tBad command usage!");
+        return (0);
+    }
+
     if (0 == nvs_data_wlab_pub_period_set(&pub_period)) {
-        shell_fprintf(shell, SHELL_NORMAL, "pub_period: %u [secs]\n",
+        shell_fprintf(shell, SHELL_NORMAL, "pub_period: %u [mins]\n",
                       pub_period);
         shell_fprintf(shell, SHELL_NORMAL, "\tOK!\n");
     } else {
@@ -128,6 +163,33 @@ static int cmd_wlab_publish_period(const struct shell *shell, size_t argc,
     return (0);
 }
 
+// $ wlabfmt <json|bin>
+static int cmd_wlab_payload_fmt(const struct shell *shell, size_t argc,
+                                char *argv[]) {
+    if (argc != 2) {
+        shell_fprintf(shell, SHELL_NORMAL, "\tBad command usage!");
+        return (0);
+    }
+
+    uint32_t payload_fmt = WLAB_CODEC_JSON;
+    if (0 == strcmp(argv[1], "json")) {
+        payload_fmt = WLAB_CODEC_JSON;
+    } else if (0 == strcmp(argv[1], "bin")) {
+        payload_fmt = WLAB_CODEC_BIN;
+    } else {
+        shell_fprintf(shell, SHELL_NORMAL, "\tBad command usage!");
+        return (0);
+    }
+
+    if (0 == nvs_data_wlab_payload_fmt_set(&payload_fmt)) {
+        shell_fprintf(shell, SHELL_NORMAL, "payload_fmt: %s\n", argv[1]);
+        shell_fprintf(shell, SHELL_NORMAL, "\tOK!\n");
+    } else {
+        shell_fprintf(shell, SHELL_NORMAL, "\tFailed!\n");
+    }
+    return (0);
+}
+
 // $ wlabgpsp <timezone> <latitude> <longitude>
 static int cmd_wlab_gps_position(const struct shell *shell, size_t argc,
                                  char *argv[]) {
@@ -158,7 +220,9 @@ static int cmd_pconfig(const struct shell *shell, size_t argc, char *argv[]) {
     struct gps_position gpspos = {};
     uint64_t device_id = 0;
     uint32_t pub_period = 0;
+    uint32_t payload_fmt = 0;
     char wlab_name[CONFIG_BUFF_MAX_STRING_LEN];
+    char servers[CONFIG_SNTP_SERVERS_MAX_LEN];
 
     nvs_data_wifi_config_get(&wificfg);
     nvs_data_mqtt_config_get(&mqttcfg);
@@ -166,6 +230,8 @@ static int cmd_pconfig(const struct shell *shell, size_t argc, char *argv[]) {
     nvs_data_wlab_name_get(wlab_name);
     nvs_data_wlab_gps_position_get(&gpspos);
     nvs_data_wlab_pub_period_get(&pub_period);
+    nvs_data_wlab_payload_fmt_get(&payload_fmt);
+    nvs_data_sntp_servers_get(servers);
 
     shell_fprintf(shell, SHELL_NORMAL, "wifi_ssid: <%s>\n", wificfg.wifi_ssid);
     shell_fprintf(shell, SHELL_NORMAL, "wifi_pass: <%s>\n", wificfg.wifi_pass);
@@ -182,15 +248,299 @@ static int cmd_pconfig(const struct shell *shell, size_t argc, char *argv[]) {
     shell_fprintf(shell, SHELL_NORMAL, "device_id: %" PRIX64 "\n", device_id);
     shell_fprintf(shell, SHELL_NORMAL, "pub_period: %u [mins]\n", pub_period);
     shell_fprintf(shell, SHELL_NORMAL, "wlab_name: <%s>\n", wlab_name);
+    shell_fprintf(shell, SHELL_NORMAL, "payload_fmt: %s\n",
+                  (WLAB_CODEC_BIN == payload_fmt) ? "bin" : "json");
+    shell_fprintf(shell, SHELL_NORMAL, "sntp_servers: <%s>\n", servers);
+    return (0);
+}
+
+// $ wlabstat
+static int cmd_wlab_stats(const struct shell *shell, size_t argc,
+                          char *argv[]) {
+    struct wlab_serie_stats stats = {0};
+    struct wlab_window_stats windows = {0};
+
+    for (uint32_t idx = 0; 0 == wlab_serie_stats_get(idx, &stats); idx++) {
+        shell_fprintf(shell, SHELL_NORMAL, "%s: accepted %u rejected %u\n",
+                      stats.name, stats.accepted, stats.rejected);
+    }
+    wlab_window_stats_get(&windows);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "windows: closed %u empty %u partial %u suppressed %u\n",
+                  windows.closed, windows.empty, windows.partial,
+                  windows.suppressed);
+    return (0);
+}
+
+// $ wlabnow
+static int cmd_wlab_now(const struct shell *shell, size_t argc, char *argv[]) {
+    struct wlab_slide_value val = {0};
+    char avg[WLAB_CODEC_NUM_MAX_LEN];
+    char min[WLAB_CODEC_NUM_MAX_LEN];
+    char max[WLAB_CODEC_NUM_MAX_LEN];
+
+    for (uint32_t idx = 0; idx < WLAB_SERIES_CNT; idx++) {
+        const struct wlab_serie_desc *desc = &WlabSeries[idx];
+        if (0 != wlab_serie_slide_get(idx, &val)) {
+            shell_fprintf(shell, SHELL_NORMAL, "%s: no samples\n",
+                          desc->name);
+            continue;
+        }
+        wlab_itostrf(avg, val.avg, desc->scale);
+        wlab_itostrf(min, val.min, desc->scale);
+        wlab_itostrf(max, val.max, desc->scale);
+        shell_fprintf(shell, SHELL_NORMAL,
+                      "%s: avg %s min %s (%u) max %s (%u), %u samples since "
+                      "%u\n",
+                      desc->name, avg, min, val.min_ts, max, val.max_ts,
+                      val.cnt, val.first_ts);
+    }
+    return (0);
+}
+
+// $ wlabalarm
+static int cmd_wlab_alarm(const struct shell *shell, size_t argc,
+                          char *argv[]) {
+    struct wlab_alarm_stats stats = {0};
+
+    for (uint32_t idx = 0; idx < WLAB_SERIES_CNT; idx++) {
+        uint32_t active = wlab_alarm_active_get(idx);
+        shell_fprintf(shell, SHELL_NORMAL, "%s:", WlabSeries[idx].name);
+        for (int kind = 0; kind < WLAB_ALARM_KINDS; kind++) {
+            if (0 != (active & BIT(kind))) {
+                shell_fprintf(shell, SHELL_NORMAL, " %s",
+                              wlab_alarm_kind_name(kind));
+            }
+        }
+        shell_fprintf(shell, SHELL_NORMAL, "%s\n",
+                      (0 == active) ? " no alarm" : "");
+    }
+
+    wlab_alarm_stats_get(&stats);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "raised %u cleared %u published %u failed %u\n",
+                  stats.raised, stats.cleared, stats.published, stats.failed);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "latency_ms: last %u max %u avg %u\n",
+                  stats.latency_ms_last, stats.latency_ms_max,
+                  (uint32_t)(stats.latency_ms_sum / MAX(stats.published, 1)));
     return (0);
 }
 
+// (the first dht sensor)  $ dhtstat
+// (given dht sensor)      $ dhtstat <device>
+static int cmd_dht_stats(const struct shell *shell, size_t argc,
+                         char *argv[]) {
+    const struct device *dev = DEVICE_DT_GET_OR_NULL(DT_INST(0, wlab_dht2x));
+    struct dht2x_stats stats = {0};
+
+    if (!IN_RANGE(argc, 1, 2)) {
+        shell_fprintf(shell, SHELL_NORMAL, "\tBad command usage!");
+        return (0);
+    }
+    if (2 == argc) {
+        dev = device_get_binding(argv[1]);
+    }
+    if (NULL == dev) {
+        shell_fprintf(shell, SHELL_NORMAL, "\tNo dht device!\n");
+        return (0);
+    }
+
+    dht2x_stats_get(dev, &stats);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "reads %u timeouts %u checksum errors %u recovered %u\n",
+                  stats.reads, stats.timeouts, stats.checksum_errors,
+                  stats.recovered);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "latency max %u bit threshold %u [usecs]\n",
+                  stats.latency_max_us, stats.threshold_us);
+
+    shell_fprintf(shell, SHELL_NORMAL, "latency from %u step %u [msecs]:",
+                  DHT2X_LATENCY_HIST_MIN_MS, DHT2X_LATENCY_HIST_STEP_MS);
+    for (int i = 0; i < DHT2X_LATENCY_HIST_BINS; i++) {
+        shell_fprintf(shell, SHELL_NORMAL, " %u", stats.latency_hist[i]);
+    }
+    shell_fprintf(shell, SHELL_NORMAL, "\nperiod from %u step %u [usecs]:",
+                  DHT2X_PULSE_HIST_MIN_US, DHT2X_PULSE_HIST_STEP_US);
+    for (int i = 0; i < DHT2X_PULSE_HIST_BINS; i++) {
+        shell_fprintf(shell, SHELL_NORMAL, " %u", stats.pulse_hist[i]);
+    }
+    shell_fprintf(shell, SHELL_NORMAL, "\nedges at timeout, step %u:",
+                  DHT2X_TIMEOUT_HIST_STEP_CNT);
+    for (int i = 0; i < DHT2X_TIMEOUT_HIST_BINS; i++) {
+        shell_fprintf(shell, SHELL_NORMAL, " %u", stats.timeout_hist[i]);
+    }
+    shell_fprintf(shell, SHELL_NORMAL, "\n");
+    return (0);
+}
+
+// $ sched
+static int cmd_sched_stats(const struct shell *shell, size_t argc,
+                           char *argv[]) {
+    struct task_sched_stats stats = {0};
+    const char *name = NULL;
+
+    for (uint32_t idx = 0; 0 == task_sched_stats_get(idx, &name, &stats);
+         idx++) {
+        uint32_t avg = (0 < stats.runs) ? (stats.run_us_total / stats.runs) : 0;
+        shell_fprintf(shell, SHELL_NORMAL,
+                      "%s: runs %u run avg %u max %u late max %u [usecs]\n",
+                      name, stats.runs, avg, stats.run_us_max,
+                      stats.late_us_max);
+        shell_fprintf(shell, SHELL_NORMAL, "\trun  :");
+        for (int i = 0; i < TASK_SCHED_HIST_BINS; i++) {
+            shell_fprintf(shell, SHELL_NORMAL, " %u", stats.run_hist[i]);
+        }
+        shell_fprintf(shell, SHELL_NORMAL, "\n\tlate :");
+        for (int i = 0; i < TASK_SCHED_HIST_BINS; i++) {
+            shell_fprintf(shell, SHELL_NORMAL, " %u", stats.late_hist[i]);
+        }
+        shell_fprintf(shell, SHELL_NORMAL, "\n");
+    }
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "histogram bin i: below %u << i [usecs], last bin above\n",
+                  TASK_SCHED_HIST_MIN);
+
+#if defined(CONFIG_SCHED_THREAD_USAGE_ALL)
+    k_thread_runtime_stats_t rt = {0};
+    if ((0 == k_thread_runtime_stats_all_get(&rt)) && (0 < rt.total_cycles)) {
+        shell_fprintf(shell, SHELL_NORMAL, "cpu idle: %u [%%]\n",
+                      (uint32_t)(100 * rt.idle_cycles / rt.total_cycles));
+    }
+#endif
+    return (0);
+}
+
+// $ ntpstat
+static int cmd_ntp_stats(const struct shell *shell, size_t argc,
+                         char *argv[]) {
+    struct timestamp_stats stats = {0};
+
+    timestamp_stats_get(&stats);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "syncs %u failures %u period %u [secs]\n", stats.syncs,
+                  stats.failures, stats.period_sec);
+    shell_fprintf(shell, SHELL_NORMAL, "rtt last %u max %u [usecs]\n",
+                  stats.rtt_us_last, stats.rtt_us_max);
+    shell_fprintf(shell, SHELL_NORMAL, "offset last %d max %u [usecs]\n",
+                  stats.offset_us_last, stats.offset_us_max);
+    shell_fprintf(shell, SHELL_NORMAL, "freq %d [ppb]\n", stats.freq_ppb);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "server %u answers %u outliers %u\n", stats.server,
+                  stats.answers, stats.outliers);
+    shell_fprintf(shell, SHELL_NORMAL, "start %s\n",
+                  (TIMESTAMP_START_RETAINED == stats.start) ? "retained"
+                  : (TIMESTAMP_START_NVS == stats.start)    ? "nvs"
+                                                            : "cold");
+    return (0);
+}
+
+// $ acqstat
+static int cmd_acq_stats(const struct shell *shell, size_t argc,
+                         char *argv[]) {
+    struct wlab_acq_stats stats = {0};
+
+    wlab_acq_stats_get(&stats);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "samples %u missed periods %u dropped %u\n", stats.samples,
+                  stats.missed, stats.dropped);
+    shell_fprintf(shell, SHELL_NORMAL, "period %u [msecs] changes %u\n",
+                  stats.period_ms, stats.period_changes);
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "read max %u jitter max %u [usecs]\n\tjitter:",
+                  stats.read_us_max, stats.jitter_us_max);
+    for (int i = 0; i < WLAB_ACQ_HIST_BINS; i++) {
+        shell_fprintf(shell, SHELL_NORMAL, " %u", stats.jitter_hist[i]);
+    }
+    shell_fprintf(shell, SHELL_NORMAL,
+                  "\nhistogram bin i: below %u << i [usecs], last bin above\n",
+                  WLAB_ACQ_HIST_MIN);
+    return (0);
+}
+
+#if defined(CONFIG_WLAB_BENCH)
+// $ wlabbench
+static int cmd_wlab_bench(const struct shell *shell, size_t argc,
+                          char *argv[]) {
+    struct wlab_bench_result res = {0};
+    int ret = 0;
+
+    for (uint32_t idx = 0; -ENOENT != ret; idx++) {
+        ret = wlab_bench_run(idx, &res);
+        if (0 == ret) {
+            shell_fprintf(shell, SHELL_NORMAL,
+                          "%s: %u cycles %u [nsecs] %u bytes stack %u\n",
+                          res.name, res.cycles,
+                          (uint32_t)k_cyc_to_ns_floor64(res.cycles), res.bytes,
+                          res.stack);
+        } else if (-ENOENT != ret) {
+            shell_fprintf(shell, SHELL_NORMAL, "%s: failed %d\n", res.name,
+                          ret);
+        }
+    }
+    return (0);
+}
+#endif
+
 SHELL_CMD_REGISTER(pconfig, NULL,
                    "Print all custom user config\n"
                    "Usage:                      \n"
                    "$ pconfig                     ",
                    cmd_pconfig);
 
+SHELL_CMD_REGISTER(wlabstat, NULL,
+                   "Print wlab series runtime statistics\n"
+                   "Usage:                      \n"
+                   "$ wlabstat                    ",
+                   cmd_wlab_stats);
+
+SHELL_CMD_REGISTER(wlabnow, NULL,
+                   "Print rolling values of the last "
+                   STRINGIFY(CONFIG_WLAB_SLIDE_WINDOW_SECS) " secs\n"
+                   "Usage:                      \n"
+                   "$ wlabnow                     ",
+                   cmd_wlab_now);
+
+SHELL_CMD_REGISTER(wlabalarm, NULL,
+                   "Print active alarms and alarm publish latency\n"
+                   "Usage:                      \n"
+                   "$ wlabalarm                   ",
+                   cmd_wlab_alarm);
+
+#if defined(CONFIG_WLAB_BENCH)
+SHELL_CMD_REGISTER(wlabbench, NULL,
+                   "Run wlab hot path benchmarks\n"
+                   "Usage:                      \n"
+                   "$ wlabbench                   ",
+                   cmd_wlab_bench);
+#endif
+
+SHELL_CMD_REGISTER(dhtstat, NULL,
+                   "Print DHT read statistics\n"
+                   "Usage:\n"
+                   "(the first dht sensor)  $ dhtstat\n"
+                   "(given dht sensor)      $ dhtstat <device>\n"
+                   "(given dht sensor)      $ dhtstat dht0",
+                   cmd_dht_stats);
+
+SHELL_CMD_REGISTER(sched, NULL,
+                   "Print scheduler tasks run time and lateness\n"
+                   "Usage:                      \n"
+                   "$ sched                       ",
+                   cmd_sched_stats);
+
+SHELL_CMD_REGISTER(ntpstat, NULL,
+                   "Print sntp synchronization statistics\n"
+                   "Usage:                      \n"
+                   "$ ntpstat                     ",
+                   cmd_ntp_stats);
+
+SHELL_CMD_REGISTER(acqstat, NULL,
+                   "Print sensor acquisition period and jitter\n"
+                   "Usage:                      \n"
+                   "$ acqstat                     ",
+                   cmd_acq_stats);
+
 SHELL_CMD_REGISTER(wificonf, NULL,
                    "Configure wifi credentials\n"
                    "Usage:\n"
@@ -223,6 +573,13 @@ SHELL_CMD_REGISTER(wlabname, NULL,
                    "$ wlabname WLAB_STATION           ",
                    cmd_wlab_name);
 
+SHELL_CMD_REGISTER(ntpconf, NULL,
+                   "Set sntp server list, up to 4 servers queried together\n"
+                   "Usage:\n"
+                   "$ ntpconf <server>[,<server>...]\n"
+                   "$ ntpconf 0.pl.pool.ntp.org,time.google.com",
+                   cmd_ntp_config);
+
 SHELL_CMD_REGISTER(wlabpubp, NULL,
                    "Set wlab publish period in seconds\n"
                    "Usage:\n"
@@ -230,6 +587,13 @@ SHELL_CMD_REGISTER(wlabpubp, NULL,
                    "$ wlabpubp 10                     ",
                    cmd_wlab_publish_period);
 
+SHELL_CMD_REGISTER(wlabfmt, NULL,
+                   "Set wlab payload format, bin is published to /wlabdb/bin\n"
+                   "Usage:\n"
+                   "$ wlabfmt <json|bin>\n"
+                   "$ wlabfmt bin                     ",
+                   cmd_wlab_payload_fmt);
+
 SHELL_CMD_REGISTER(wlabgpsp, NULL,
                    "Set wlab gps position\n"
                    "Usage:\n"
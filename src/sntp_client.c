@@ -0,0 +1,324 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sntp_client.c
+ * --------------------------------------------------------------------------*/
+#include "sntp_client.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/dns_resolve.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
+
+LOG_MODULE_REGISTER(SNTPC, LOG_LEVEL_DBG);
+
+#define SNTP_CLIENT_PORT         (123)
+#define SNTP_CLIENT_PKT_LEN      (48)
+#define SNTP_CLIENT_HOST_MAX_LEN (64)
+#define SNTP_CLIENT_LIST_MAX_LEN \
+    (SNTP_CLIENT_MAX_SERVERS * SNTP_CLIENT_HOST_MAX_LEN)
+#define SNTP_CLIENT_CONSISTENT_US (100 * USEC_PER_MSEC)
+#define SNTP_CLIENT_EPOCH_OFFSET (2208988800ULL) /* 1900 to 1970 secs */
+
+/* li 0, version 4, mode 3 - client */
+#define SNTP_CLIENT_REQ_FLAGS   (0x23)
+#define SNTP_CLIENT_MODE_SERVER (4)
+#define SNTP_CLIENT_LI_ALARM    (3)
+
+struct sntp_client_server {
+    const char *host;
+    struct sockaddr addr;
+    bool resolved;
+    volatile bool resolving; /* resolver may still write addr */
+    uint16_t dns_id;
+    struct k_sem *resolve_done; /* given once resolution finished */
+    int sock;
+    uint32_t nonce[2]; /* sent as transmit time, echoed as originate time */
+    int64_t sent_us;
+    bool answered;
+    struct sntp_client_result res;
+};
+
+static int64_t sntp_client_uptime_us(void) {
+    return (k_ticks_to_us_floor64(k_uptime_ticks()));
+}
+
+/**
+ * @brief Convert 64 bit ntp timestamp to unix epoch usecs.
+ */
+static int64_t sntp_client_ts_us(const uint8_t *ts) {
+    uint64_t secs = sys_get_be32(ts);
+    uint64_t frac = sys_get_be32(ts + 4);
+
+    return ((secs - SNTP_CLIENT_EPOCH_OFFSET) * USEC_PER_SEC +
+            ((frac * USEC_PER_SEC) >> 32));
+}
+
+/**
+ * @brief Resolver callback, runs in dns resolver context. The first ipv4
+ * address is taken, resolution is done with any final status.
+ */
+static void sntp_client_resolved(enum dns_resolve_status status,
+                                 struct dns_addrinfo *info, void *user_data) {
+    struct sntp_client_server *srv = user_data;
+
+    if (DNS_EAI_INPROGRESS == status) {
+        if ((NULL != info) && (AF_INET == info->ai_family) &&
+            !srv->resolved) {
+            memcpy(&srv->addr, &info->ai_addr, sizeof(struct sockaddr_in));
+            srv->resolved = true;
+        }
+        return;
+    }
+
+    if (!srv->resolved) {
+        LOG_WRN("%s, resolve failed status:%d", srv->host, status);
+    }
+    srv->resolving = false;
+    k_sem_give(srv->resolve_done);
+}
+
+/**
+ * @brief Start resolution of server host name, numeric address is resolved
+ * at once. Resolver gives up after timeout_ms on its own.
+ *
+ * @return int 0 - resolution pending, 1 - resolved, negative errno code
+ * otherwise
+ */
+static int sntp_client_resolve(struct sntp_client_server *srv,
+                               uint32_t timeout_ms) {
+    struct sockaddr_in *sin = net_sin(&srv->addr);
+    int ret = 0;
+
+    sin->sin_family = AF_INET;
+    if (1 == zsock_inet_pton(AF_INET, srv->host, &sin->sin_addr)) {
+        srv->resolved = true;
+        return (1);
+    }
+
+    srv->resolving = true;
+    ret = dns_get_addr_info(srv->host, DNS_QUERY_TYPE_A, &srv->dns_id,
+                            sntp_client_resolved, srv, timeout_ms);
+    if (0 != ret) {
+        srv->resolving = false;
+        LOG_WRN("%s, resolve failed rc:%d", srv->host, ret);
+    }
+    return (ret);
+}
+
+static int sntp_client_send(struct sntp_client_server *srv) {
+    uint8_t pkt[SNTP_CLIENT_PKT_LEN] = {0};
+    int ret = 0;
+
+    net_sin(&srv->addr)->sin_port = htons(SNTP_CLIENT_PORT);
+    srv->sock = zsock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (0 > srv->sock) {
+        ret = -errno;
+        goto send_done;
+    }
+
+    ret = zsock_connect(srv->sock, &srv->addr, sizeof(struct sockaddr_in));
+    if (0 != ret) {
+        ret = -errno;
+        goto send_done;
+    }
+
+    /* random transmit time, server echoes it back, so answer can be matched
+     * with the request and local time is not disclosed */
+    srv->nonce[0] = sys_rand32_get();
+    srv->nonce[1] = sys_rand32_get();
+    pkt[0] = SNTP_CLIENT_REQ_FLAGS;
+    memcpy(&pkt[40], srv->nonce, sizeof(srv->nonce));
+
+    srv->sent_us = sntp_client_uptime_us();
+    if (SNTP_CLIENT_PKT_LEN != zsock_send(srv->sock, pkt, sizeof(pkt), 0)) {
+        ret = -errno;
+        goto send_done;
+    }
+    ret = 0;
+
+send_done:
+    if ((0 != ret) && (0 <= srv->sock)) {
+        zsock_close(srv->sock);
+        srv->sock = -1;
+    }
+    if (0 != ret) {
+        LOG_WRN("%s, send failed rc:%d", srv->host, ret);
+    }
+    return (ret);
+}
+
+static void sntp_client_recv(struct sntp_client_server *srv) {
+    uint8_t pkt[SNTP_CLIENT_PKT_LEN] = {0};
+    int64_t recv_us = sntp_client_uptime_us();
+
+    ssize_t len = zsock_recv(srv->sock, pkt, sizeof(pkt), 0);
+    if ((SNTP_CLIENT_PKT_LEN > len) ||
+        (SNTP_CLIENT_MODE_SERVER != (pkt[0] & 0x07)) ||
+        (SNTP_CLIENT_LI_ALARM == (pkt[0] >> 6)) ||
+        (!IN_RANGE(pkt[1], 1, 15)) ||
+        (0 != memcmp(&pkt[24], srv->nonce, sizeof(srv->nonce)))) {
+        /* not an answer to our request, keep waiting */
+        return;
+    }
+
+    int64_t t2 = sntp_client_ts_us(&pkt[32]); /* server receive */
+    int64_t t3 = sntp_client_ts_us(&pkt[40]); /* server transmit */
+    int64_t rtt = (recv_us - srv->sent_us) - (t3 - t2);
+
+    srv->res.uptime_us = srv->sent_us + (recv_us - srv->sent_us) / 2;
+    srv->res.epoch_us = t2 + (t3 - t2) / 2;
+    srv->res.rtt_us = CLAMP(rtt, 0, UINT32_MAX);
+    srv->answered = true;
+}
+
+/**
+ * @brief Clock offset of answer, server epoch minus local uptime.
+ */
+static int64_t sntp_client_offset(const struct sntp_client_server *srv) {
+    return (srv->res.epoch_us - srv->res.uptime_us);
+}
+
+static int sntp_client_select(struct sntp_client_server *srv, uint32_t cnt,
+                              struct sntp_client_result *res) {
+    int64_t offsets[SNTP_CLIENT_MAX_SERVERS];
+    int64_t median = 0;
+    uint32_t answers = 0, outliers = 0;
+    int best = -1;
+
+    /* insertion sort of answered offsets */
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (!srv[i].answered) {
+            continue;
+        }
+        int64_t offset = sntp_client_offset(&srv[i]);
+        uint32_t j = answers++;
+        while ((0 < j) && (offsets[j - 1] > offset)) {
+            offsets[j] = offsets[j - 1];
+            j--;
+        }
+        offsets[j] = offset;
+    }
+    if (0 == answers) {
+        return (-ETIMEDOUT);
+    }
+    median = offsets[answers / 2];
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (!srv[i].answered) {
+            continue;
+        }
+        if (SNTP_CLIENT_CONSISTENT_US <
+            llabs(sntp_client_offset(&srv[i]) - median)) {
+            LOG_WRN("Server %u discarded, offset %lld us from median", i,
+                    sntp_client_offset(&srv[i]) - median);
+            outliers++;
+            continue;
+        }
+        if ((0 > best) || (srv[i].res.rtt_us < srv[best].res.rtt_us)) {
+            best = i;
+        }
+    }
+
+    /* without majority consistent with median, e.g. two answers apart, it can
+     * not be told which server is wrong */
+    if (2 * (answers - outliers) <= answers) {
+        LOG_WRN("No majority of %u answers consistent", answers);
+        return (-ERANGE);
+    }
+
+    *res = srv[best].res;
+    res->server = best;
+    res->answers = answers;
+    res->outliers = outliers;
+    return (0);
+}
+
+int sntp_client_query(const char *servers, uint32_t timeout_ms,
+                      struct sntp_client_result *res) {
+    struct sntp_client_server srv[SNTP_CLIENT_MAX_SERVERS] = {0};
+    struct zsock_pollfd fds[SNTP_CLIENT_MAX_SERVERS] = {0};
+    char list[SNTP_CLIENT_LIST_MAX_LEN];
+    char *host = NULL, *save = NULL;
+    uint32_t cnt = 0, pending = 0, resolving = 0;
+    struct k_sem resolve_done;
+    int64_t deadline_ms = k_uptime_get() + timeout_ms;
+
+    strncpy(list, servers, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+    k_sem_init(&resolve_done, 0, SNTP_CLIENT_MAX_SERVERS);
+
+    /* all names are resolved in parallel, in the first half of timeout, so
+     * slow or unresolvable server delays sync only by that */
+    for (host = strtok_r(list, ", ", &save);
+         (NULL != host) && (cnt < SNTP_CLIENT_MAX_SERVERS);
+         host = strtok_r(NULL, ", ", &save)) {
+        srv[cnt].host = host;
+        srv[cnt].sock = -1;
+        srv[cnt].resolve_done = &resolve_done;
+        if (0 == sntp_client_resolve(&srv[cnt], timeout_ms / 2)) {
+            resolving++;
+        }
+        cnt++;
+    }
+
+    /* resolver reports every started resolution, at latest on its timeout,
+     * anything left is cancelled, so srv is not written after return */
+    while (0 < resolving) {
+        int64_t wait_ms = MAX(deadline_ms - k_uptime_get(), 0);
+        if (0 != k_sem_take(&resolve_done, K_MSEC(wait_ms))) {
+            break;
+        }
+        resolving--;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (srv[i].resolving) {
+            dns_cancel_addr_info(srv[i].dns_id);
+        }
+    }
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (srv[i].resolved && (0 == sntp_client_send(&srv[i]))) {
+            pending++;
+        }
+        fds[i].fd = srv[i].sock;
+        fds[i].events = ZSOCK_POLLIN;
+    }
+
+    while (0 < pending) {
+        int64_t wait_ms = deadline_ms - k_uptime_get();
+        if ((0 >= wait_ms) || (0 >= zsock_poll(fds, cnt, wait_ms))) {
+            break;
+        }
+        for (uint32_t i = 0; i < cnt; i++) {
+            if ((0 > fds[i].fd) || (0 == (fds[i].revents & ZSOCK_POLLIN))) {
+                continue;
+            }
+            sntp_client_recv(&srv[i]);
+            if (srv[i].answered) {
+                /* negative fd is ignored by poll */
+                fds[i].fd = -1;
+                pending--;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (0 <= srv[i].sock) {
+            zsock_close(srv[i].sock);
+        }
+    }
+
+    return (sntp_client_select(srv, cnt, res));
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
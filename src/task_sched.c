@@ -0,0 +1,129 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: task_sched.c
+ * --------------------------------------------------------------------------*/
+#include "task_sched.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(SCHED, LOG_LEVEL_DBG);
+
+#define TASK_SCHED_STACK_SIZE (4 * 1024)
+#define TASK_SCHED_PRIORITY   (4)
+
+K_THREAD_STACK_DEFINE(TaskSchedStack, TASK_SCHED_STACK_SIZE);
+static struct k_work_q TaskSchedQ;
+
+static struct task_sched_task *Tasks[CONFIG_TASK_SCHED_MAX_TASKS];
+static uint32_t TasksCnt = 0;
+static K_MUTEX_DEFINE(TasksLock);
+
+static uint32_t task_sched_hist_bin(uint32_t usecs) {
+    uint32_t bin = 0;
+    while ((TASK_SCHED_HIST_BINS - 1 > bin) &&
+           ((TASK_SCHED_HIST_MIN << bin) <= usecs)) {
+        bin++;
+    }
+    return (bin);
+}
+
+static void task_sched_handler(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct task_sched_task *task =
+        CONTAINER_OF(dwork, struct task_sched_task, work);
+    struct task_sched_stats *stats = &task->stats;
+
+    int64_t start_us = k_ticks_to_us_floor64(k_uptime_ticks());
+    int64_t late_us = start_us - (task->due_ms * USEC_PER_MSEC);
+    uint32_t start_cyc = k_cycle_get_32();
+
+    int64_t next_ms = task->fn(task->due_ms);
+
+    uint32_t run_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+    late_us = CLAMP(late_us, 0, UINT32_MAX);
+
+    k_mutex_lock(&TasksLock, K_FOREVER);
+    stats->runs++;
+    stats->run_us_total += run_us;
+    stats->run_us_max = MAX(stats->run_us_max, run_us);
+    stats->late_us_max = MAX(stats->late_us_max, (uint32_t)late_us);
+    stats->run_hist[task_sched_hist_bin(run_us)]++;
+    stats->late_hist[task_sched_hist_bin(late_us)]++;
+    task->due_ms = next_ms;
+    k_mutex_unlock(&TasksLock);
+
+    if (TASK_SCHED_STOP == next_ms) {
+        return;
+    }
+
+    k_work_reschedule_for_queue(&TaskSchedQ, &task->work,
+                                K_TIMEOUT_ABS_MS(next_ms));
+}
+
+void task_sched_init(void) {
+    const struct k_work_queue_config cfg = {.name = "task_sched"};
+
+    k_work_queue_init(&TaskSchedQ);
+    k_work_queue_start(&TaskSchedQ, TaskSchedStack,
+                       K_THREAD_STACK_SIZEOF(TaskSchedStack),
+                       TASK_SCHED_PRIORITY, &cfg);
+}
+
+void task_sched_start(struct task_sched_task *task, const char *name,
+                      task_sched_fn_t fn, int64_t due_ms) {
+    k_mutex_lock(&TasksLock, K_FOREVER);
+    __ASSERT((TasksCnt < CONFIG_TASK_SCHED_MAX_TASKS), "Too many tasks");
+    memset(&task->stats, 0x00, sizeof(task->stats));
+    task->name = name;
+    task->fn = fn;
+    task->due_ms = due_ms;
+    Tasks[TasksCnt++] = task;
+    k_mutex_unlock(&TasksLock);
+
+    k_work_init_delayable(&task->work, task_sched_handler);
+    k_work_reschedule_for_queue(&TaskSchedQ, &task->work,
+                                K_TIMEOUT_ABS_MS(due_ms));
+    LOG_INF("Task %s started", name);
+}
+
+int task_sched_stats_get(uint32_t idx, const char **name,
+                         struct task_sched_stats *stats) {
+    int ret = 0;
+
+    k_mutex_lock(&TasksLock, K_FOREVER);
+    if (TasksCnt <= idx) {
+        ret = -ENOENT;
+    } else {
+        *name = Tasks[idx]->name;
+        memcpy(stats, &Tasks[idx]->stats, sizeof(struct task_sched_stats));
+    }
+    k_mutex_unlock(&TasksLock);
+
+    return (ret);
+}
+
+const char *task_sched_stalled(void) {
+    const char *name = NULL;
+    int64_t now_ms = k_uptime_get();
+
+    k_mutex_lock(&TasksLock, K_FOREVER);
+    for (uint32_t i = 0; i < TasksCnt; i++) {
+        /* stopped task is due at TASK_SCHED_STOP, never overdue */
+        if (Tasks[i]->due_ms < now_ms - CONFIG_TASK_SCHED_STALL_MS) {
+            name = Tasks[i]->name;
+            break;
+        }
+    }
+    k_mutex_unlock(&TasksLock);
+
+    return (name);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
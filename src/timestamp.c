@@ -5,59 +5,333 @@
  * --------------------------------------------------------------------------*/
 #include "timestamp.h"
 
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
-#include <zephyr/net/sntp.h>
-#include <zephyr/sys/reboot.h>
 
-#include "wdg.h"
+#include "nvs_data.h"
+#include "sntp_client.h"
 
 LOG_MODULE_REGISTER(TS, LOG_LEVEL_DBG);
 
+#define TIMESTAMP_STACK_SIZE       (3 * 1024)
+#define TIMESTAMP_PRIORITY         (8)
+#define TIMESTAMP_RETRY_PERIOD_SEC (10) /* doubled after every failure */
+#define TIMESTAMP_STEP_MS          (1000) /* larger offset is stepped */
+#define TIMESTAMP_SLEW_PPM         (500)  /* max rate of offset correction */
+#define TIMESTAMP_FREQ_MAX_PPB     (500000)
+#define TIMESTAMP_FREQ_MIN_SEC     (60) /* shortest base for freq estimate */
+#define TIMESTAMP_ACCURACY_MS      (50) /* longer resync when offset below */
+#define TIMESTAMP_QUERY_TIMEOUT_MS (2000)
+#define TIMESTAMP_PERSIST_SEC      (3600) /* min period of nvs checkpoint */
+#define TIMESTAMP_RETAINED_MAGIC   (0x57544d53)
+
 /**
  * @brief Call with some period to be sure that internal timer is up-to-data.
  *
  * @return int Negative errno.
  */
 static int timestamp_sync(void);
+static void timestamp_sync_handler(struct k_work *work);
+
+/* Local clock is uptime disciplined by sntp, epoch is
+ * ref_epoch_us + dt * (1 + freq_ppb / 1e9) +- slew, where dt is uptime since
+ * ref_uptime_us and slew absorbs slew_us offset at TIMESTAMP_SLEW_PPM rate.
+ * Clock is re-anchored at every sync, so it never steps back for small
+ * offsets. */
+struct timestamp_clock {
+    int64_t ref_uptime_us;
+    int64_t ref_epoch_us;
+    int64_t slew_us;
+    int32_t freq_ppb;
+};
+
+/* Epoch kept in ram not cleared by warm reset, refreshed every second, so
+ * clock restarts within about a second of true time after watchdog reset */
+struct timestamp_retained {
+    uint32_t magic;
+    uint32_t check;
+    int64_t epoch_ms;
+};
+
+/* Sntp query blocks up to 2 s, it runs in its own low priority work queue so
+ * no other task waits for it */
+K_THREAD_STACK_DEFINE(TimestampStack, TIMESTAMP_STACK_SIZE);
+static struct k_work_q TimestampQ;
+static struct k_work_delayable SyncWork;
+static uint32_t RetrySec = 1;
+static void timestamp_checkpoint_handler(struct k_timer *timer);
+K_TIMER_DEFINE(CheckpointTimer, timestamp_checkpoint_handler, NULL);
+static __noinit struct timestamp_retained Retained;
+
+/* Clock and Stats are published to readers under ClockLock */
+static struct timestamp_clock Clock = {0};
+static struct timestamp_stats Stats = {0};
+static struct k_spinlock ClockLock;
+static int64_t SyncUptimeUs = 0; /* raw pair of the last sync */
+static int64_t SyncEpochUs = 0;
+static uint32_t SyncPeriodSec = CONFIG_TIMESTAMP_UPDATE_PERIOD_SEC;
+static uint32_t FreqEstimates = 0;
+static int64_t StepUs = 0; /* first sync offset, correction of unsynced ts */
+static int64_t PersistUptimeMs = 0;
 
-static int64_t UptimeSyncMs = 0;
-static int64_t SntpSyncSec = 0;
+static int64_t timestamp_uptime_us(void) {
+    return (k_ticks_to_us_floor64(k_uptime_ticks()));
+}
+
+static int64_t timestamp_local_us(const struct timestamp_clock *clock,
+                                  int64_t uptime_us) {
+    int64_t dt = uptime_us - clock->ref_uptime_us;
+    int64_t us = clock->ref_epoch_us + dt + dt * clock->freq_ppb / 1000000000;
+    int64_t slew = dt * TIMESTAMP_SLEW_PPM / 1000000;
+
+    if (0 <= clock->slew_us) {
+        us += MIN(slew, clock->slew_us);
+    } else {
+        us -= MIN(slew, -clock->slew_us);
+    }
+    return (us);
+}
+
+static uint32_t timestamp_retained_check(int64_t epoch_ms) {
+    return (~TIMESTAMP_RETAINED_MAGIC ^ (uint32_t)epoch_ms ^
+            (uint32_t)(epoch_ms >> 32));
+}
+
+/**
+ * @brief Refresh retained epoch, runs in timer expiry every second. Clock
+ * without any time source is not retained.
+ */
+static void timestamp_checkpoint_handler(struct k_timer *timer) {
+    if ((TIMESTAMP_START_COLD == Stats.start) && !timestamp_synced()) {
+        return;
+    }
+
+    int64_t epoch_ms = timestamp_get_ms();
+    Retained.magic = TIMESTAMP_RETAINED_MAGIC;
+    Retained.epoch_ms = epoch_ms;
+    Retained.check = timestamp_retained_check(epoch_ms);
+}
 
 void timestamp_init(void) {
-    int32_t sntp_sync_attempts = 0;
-    while (0 != timestamp_sync()) {
-        sntp_sync_attempts++;
-        wdg_feed();
-        if (8 == sntp_sync_attempts) {
-            /* system reboot */
-            sys_reboot(SYS_REBOOT_COLD);
-        }
+    int64_t epoch_ms = 0;
+
+    /* the best estimate available until sntp answers: epoch retained by warm
+     * reset, otherwise the last checkpoint stored in nvs, which is at least
+     * lower bound of the actual time */
+    if ((TIMESTAMP_RETAINED_MAGIC == Retained.magic) &&
+        (timestamp_retained_check(Retained.epoch_ms) == Retained.check)) {
+        epoch_ms = Retained.epoch_ms;
+        Stats.start = TIMESTAMP_START_RETAINED;
+    } else {
+        nvs_data_timestamp_checkpoint_get(&epoch_ms);
+        Stats.start = (0 < epoch_ms) ? TIMESTAMP_START_NVS
+                                     : TIMESTAMP_START_COLD;
     }
+
+    /* retained epoch refers to reset, uptime since boot is added */
+    Clock.ref_uptime_us = 0;
+    Clock.ref_epoch_us = epoch_ms * USEC_PER_MSEC;
+    LOG_INF("Clock start %u, epoch %lld ms", Stats.start, epoch_ms);
+    k_timer_start(&CheckpointTimer, K_SECONDS(1), K_SECONDS(1));
+
+    const struct k_work_queue_config cfg = {.name = "timestamp"};
+    k_work_queue_init(&TimestampQ);
+    k_work_queue_start(&TimestampQ, TimestampStack,
+                       K_THREAD_STACK_SIZEOF(TimestampStack),
+                       TIMESTAMP_PRIORITY, &cfg);
+
+    /* nobody waits for the first sync, network may be still down */
+    k_work_init_delayable(&SyncWork, timestamp_sync_handler);
+    k_work_reschedule_for_queue(&TimestampQ, &SyncWork, K_NO_WAIT);
+}
+
+int64_t timestamp_get_ms(void) {
+    k_spinlock_key_t key = k_spin_lock(&ClockLock);
+    int64_t us = timestamp_local_us(&Clock, timestamp_uptime_us());
+    k_spin_unlock(&ClockLock, key);
+
+    return (us / USEC_PER_MSEC);
 }
 
 int64_t timestamp_get(void) {
-    int64_t sec_elapsed = (k_uptime_get() - UptimeSyncMs) / 1000;
-    return (SntpSyncSec + sec_elapsed);
+    return (timestamp_get_ms() / MSEC_PER_SEC);
 }
 
-void timestamp_update(void) {
-    int64_t actual_uptime_ms = k_uptime_get();
-    if (UptimeSyncMs + (1000 * CONFIG_TIMESTAMP_UPDATE_PERIOD_SEC) <
-        actual_uptime_ms) {
-        timestamp_sync();
+int64_t timestamp_get_checked(bool *synced) {
+    k_spinlock_key_t key = k_spin_lock(&ClockLock);
+    int64_t us = timestamp_local_us(&Clock, timestamp_uptime_us());
+    *synced = (0 < Stats.syncs);
+    k_spin_unlock(&ClockLock, key);
+
+    return (us / USEC_PER_SEC);
+}
+
+bool timestamp_synced(void) {
+    return (0 < Stats.syncs);
+}
+
+int timestamp_unsynced_correct(uint32_t *ts) {
+    int ret = 0;
+    k_spinlock_key_t key = k_spin_lock(&ClockLock);
+
+    if (0 == Stats.syncs) {
+        ret = -EAGAIN;
+    } else {
+        /* rounded to whole secs */
+        int64_t half_us = USEC_PER_SEC / 2;
+        int64_t step_us = (0 <= StepUs) ? (StepUs + half_us)
+                                        : (StepUs - half_us);
+        *ts += step_us / (int64_t)USEC_PER_SEC;
     }
+
+    k_spin_unlock(&ClockLock, key);
+    return (ret);
+}
+
+void timestamp_stats_get(struct timestamp_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&ClockLock);
+    memcpy(stats, &Stats, sizeof(struct timestamp_stats));
+    k_spin_unlock(&ClockLock, key);
+}
+
+/**
+ * @brief Store epoch of synced clock in nvs, at most every
+ * TIMESTAMP_PERSIST_SEC to save flash.
+ */
+static void timestamp_persist(void) {
+    int64_t uptime_ms = k_uptime_get();
+
+    if ((0 != PersistUptimeMs) &&
+        (TIMESTAMP_PERSIST_SEC * MSEC_PER_SEC > uptime_ms - PersistUptimeMs)) {
+        return;
+    }
+
+    int64_t epoch_ms = timestamp_get_ms();
+    if (0 == nvs_data_timestamp_checkpoint_set(&epoch_ms)) {
+        PersistUptimeMs = uptime_ms;
+    }
+}
+
+/**
+ * @brief Resync work, runs every SyncPeriodSec, failed sync is retried with
+ * exponential backoff, starting at 1 s until the first sync and at
+ * TIMESTAMP_RETRY_PERIOD_SEC later.
+ */
+static void timestamp_sync_handler(struct k_work *work) {
+    uint32_t delay_sec = SyncPeriodSec;
+
+    if (0 == timestamp_sync()) {
+        RetrySec = TIMESTAMP_RETRY_PERIOD_SEC;
+        timestamp_persist();
+    } else {
+        delay_sec = RetrySec;
+        RetrySec = MIN(2 * RetrySec, timestamp_synced()
+                                         ? SyncPeriodSec
+                                         : TIMESTAMP_RETRY_PERIOD_SEC);
+    }
+
+    k_work_reschedule_for_queue(&TimestampQ, &SyncWork, K_SECONDS(delay_sec));
+}
+
+/**
+ * @brief Discipline local clock by epoch measured at given uptime. Frequency
+ * offset is estimated from raw uptime and epoch of two successive syncs,
+ * offset is slewed, only large offset or the first sync steps the clock.
+ * Stepped offset is not a frequency error, estimate is kept then.
+ */
+static void timestamp_discipline(int64_t uptime_us, int64_t epoch_us,
+                                 uint32_t rtt_us) {
+    k_spinlock_key_t key = k_spin_lock(&ClockLock);
+    struct timestamp_clock *clock = &Clock;
+    bool first = (0 == SyncEpochUs);
+    int64_t local_us = timestamp_local_us(clock, uptime_us);
+    int64_t offset_us = epoch_us - local_us;
+    int64_t base_us = uptime_us - SyncUptimeUs;
+    bool step = first || (TIMESTAMP_STEP_MS * USEC_PER_MSEC < llabs(offset_us));
+
+    if (first) {
+        /* samples stamped by estimated clock are shifted by the first step */
+        StepUs = offset_us;
+    }
+
+    Stats.rtt_us_last = rtt_us;
+    Stats.rtt_us_max = MAX(Stats.rtt_us_max, rtt_us);
+
+    if (!step && (TIMESTAMP_FREQ_MIN_SEC * USEC_PER_SEC <= base_us)) {
+        /* drift is limited first, so scaling to ppb can not overflow */
+        int64_t drift_max_us =
+            base_us / (NSEC_PER_SEC / TIMESTAMP_FREQ_MAX_PPB);
+        int64_t drift_us = CLAMP((epoch_us - SyncEpochUs) - base_us,
+                                 -drift_max_us, drift_max_us);
+        int32_t freq_ppb = CLAMP(drift_us * NSEC_PER_MSEC /
+                                     (base_us / USEC_PER_MSEC),
+                                 -TIMESTAMP_FREQ_MAX_PPB,
+                                 TIMESTAMP_FREQ_MAX_PPB);
+        /* the first estimate is taken as is, next ones are averaged */
+        if (0 == FreqEstimates++) {
+            clock->freq_ppb = freq_ppb;
+        } else {
+            clock->freq_ppb += (freq_ppb - clock->freq_ppb) / 4;
+        }
+    }
+
+    clock->ref_uptime_us = uptime_us;
+    if (step) {
+        clock->ref_epoch_us = epoch_us;
+        clock->slew_us = 0;
+    } else {
+        clock->ref_epoch_us = local_us;
+        clock->slew_us = offset_us;
+    }
+
+    SyncUptimeUs = uptime_us;
+    SyncEpochUs = epoch_us;
+
+    /* clock keeping well gets resynced less often */
+    if (!first && (TIMESTAMP_ACCURACY_MS * USEC_PER_MSEC > llabs(offset_us))) {
+        SyncPeriodSec = MIN(2 * SyncPeriodSec,
+                            CONFIG_TIMESTAMP_UPDATE_PERIOD_MAX_SEC);
+    } else {
+        SyncPeriodSec = CONFIG_TIMESTAMP_UPDATE_PERIOD_SEC;
+    }
+
+    uint32_t offset_abs = CLAMP(llabs(offset_us), 0, UINT32_MAX);
+    Stats.syncs++;
+    Stats.offset_us_last = CLAMP(offset_us, INT32_MIN, INT32_MAX);
+    Stats.offset_us_max = first ? 0 : MAX(Stats.offset_us_max, offset_abs);
+    Stats.freq_ppb = clock->freq_ppb;
+    Stats.period_sec = SyncPeriodSec;
+    int32_t freq_ppb = clock->freq_ppb;
+    k_spin_unlock(&ClockLock, key);
+
+    LOG_INF("Clock offset %lld us, freq %d ppb, next sync in %u s",
+            offset_us, freq_ppb, SyncPeriodSec);
 }
 
 static int timestamp_sync(void) {
     int ret = 0;
-    struct sntp_time sntp_time = {0};
+    struct sntp_client_result res = {0};
+    char servers[CONFIG_SNTP_SERVERS_MAX_LEN];
 
-    ret = sntp_simple("0.pl.pool.ntp.org", 4000, &sntp_time);
+    nvs_data_sntp_servers_get(servers);
+    ret = sntp_client_query(servers, TIMESTAMP_QUERY_TIMEOUT_MS, &res);
     if (0 == ret) {
-        SntpSyncSec = (int64_t)sntp_time.seconds;
-        UptimeSyncMs = k_uptime_get();
-        LOG_INF("Acquire SNTP success");
+        k_spinlock_key_t key = k_spin_lock(&ClockLock);
+        Stats.server = res.server;
+        Stats.answers = res.answers;
+        Stats.outliers += res.outliers;
+        k_spin_unlock(&ClockLock, key);
+        timestamp_discipline(res.uptime_us, res.epoch_us, res.rtt_us);
+        LOG_INF("Acquire SNTP success, server %u of %u answers", res.server,
+                res.answers);
     } else {
+        k_spinlock_key_t key = k_spin_lock(&ClockLock);
+        Stats.failures++;
+        k_spin_unlock(&ClockLock, key);
         LOG_ERR("Failed to acquire SNTP, code %d", ret);
     }
 
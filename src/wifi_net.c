@@ -15,7 +15,6 @@
 #include <zephyr/net/wifi_mgmt.h>
 #include <zephyr/sys/reboot.h>
 
-#include "wdg.h"
 
 LOG_MODULE_REGISTER(WIFI, LOG_LEVEL_DBG);
 
@@ -94,7 +93,6 @@ void wifi_net_init(char *ssid, char *passwd) {
 
     int32_t sec_cnt = 0;
     for (sec_cnt = 0; sec_cnt < CONFIG_WIFI_FIRST_CONN_TIMEOUT_SEC; sec_cnt++) {
-        wdg_feed();
         if (0 == k_sem_take(&FirstConnSem, K_SECONDS(1))) {
             break;
         }
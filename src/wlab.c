@@ -6,148 +6,438 @@
 #include "wlab.h"
 
 #include <errno.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 #include <zephyr/device.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/reboot.h>
 
 #include "dht2x.h"
 #include "mqtt_worker.h"
 #include "nvs_data.h"
-#include "wdg.h"
+#include "sample_log.h"
+#include "task_sched.h"
+#include "timestamp.h"
 #include "wifi_net.h"
+#include "wlab_acq.h"
+#include "wlab_alarm.h"
+#include "wlab_buffer.h"
+#include "wlab_codec.h"
+#include "wlab_filter.h"
+#include "wlab_series.h"
+#include "wlab_slide.h"
 
 LOG_MODULE_REGISTER(WLAB, LOG_LEVEL_DBG);
 
-#define CONFIG_WLAB_DHT_DESC           ("DHT2X")
-#define CONFIG_WLAB_PUB_TOPIC          ("/wlabdb")
-#define CONFIG_WLAB_AUTH_TOPIC         ("/wlabauth")
-#define CONFIG_WLAB_DEVICE_ID_BUFF_LEN (13)
-#define CONFIG_WLAB_MEASURE_PERIOD     (4) /* secs */
-
-#define WLAB_TEMP_SERIE     (1)
-#define WLAB_HUMIDITY_SERIE (2)
-
-/* Sometimes max return weird value not fitted to the other if this value
- * will be more than WLAB_EXT2AVG_MAX then skip */
-#define WLAB_EXT2AVG_MAX       (32)
-#define WLAB_MIN_SAMPLES_COUNT (8)
-
-struct wlab_buffer {
-    int32_t _min;
-    int32_t _max;
-    uint32_t _max_ts;
-    uint32_t _min_ts;
-    int32_t buff;
-    int32_t cnt;
-    uint32_t sample_ts;
-    int32_t sample_ts_val;
-};
+#define CONFIG_WLAB_DHT_DESC             ("DHT2X")
+#define CONFIG_WLAB_PUB_TOPIC            ("/wlabdb")
+#define CONFIG_WLAB_PUB_BIN_TOPIC        ("/wlabdb/bin")
+#define CONFIG_WLAB_AUTH_TOPIC           ("/wlabauth")
+#define CONFIG_WLAB_DIAG_TOPIC           ("/wlabdiag")
+#define CONFIG_WLAB_DEVICE_ID_BUFF_LEN   (13)
+#define CONFIG_WLAB_AUTH_SERIES_BUFF_LEN (128)
+#define WLAB_WINDOW_GRACE_SECS                                                 \
+    (CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC + CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC)
+#define WLAB_WINDOW_EMPTY_MAX            (16) /* empty records per gap */
+#define WLAB_PUB_RETRY_MS_MIN            (1 * MSEC_PER_SEC)
+#define WLAB_PUB_RETRY_MS_MAX            (64 * MSEC_PER_SEC)
+
+BUILD_ASSERT(sizeof(struct wlab_record) <= SAMPLE_LOG_RECORD_MAX_LEN,
+             "wlab record does not fit into sample log");
 
 static int wlab_authorize(void);
-static bool wlab_buffer_commit(struct wlab_buffer *buffer, int32_t val,
-                               uint32_t ts, uint32_t threshold);
-static void wlab_buffer_init(struct wlab_buffer *buffer);
-static void wlab_itostrf(char *dst, int32_t signed_int);
 static void wlab_str_device_id_get(char dst[CONFIG_WLAB_DEVICE_ID_BUFF_LEN]);
 
 const char *AuthTemplate =
     "{\"timezone\":\"%s\",\"longitude\":%.1f,\"latitude\":%.1f,\"serie\":"
-    "{\"Temperature\":%d,\"Humidity\":%d},"
-    "\"name\":\"%s\",\"description\":\"%s\", \"uid\":\"%s\"}";
-
-const char *DHTJsonDataTemplate =
-    "{\"UID\":\"%s\",\"TS\":%d,\"SERIE\":{\"Temperature\":"
-    "{\"f_avg\":%s,\"f_act\":%s,\"f_min\":%s,\"f_max\":%s,"
-    "\"i_min_ts\":%u,\"i_max_ts\":%u},"
-    "\"Humidity\":{\"f_avg\":%s,\"f_act\":%s,\"f_min\":%s,"
-    "\"f_max\":%s,\"i_min_ts\":%u,\"i_max_ts\":%u}}}";
-
-static int wlab_dht_publish_sample(struct wlab_buffer *temp,
-                                   struct wlab_buffer *rh);
-
-static const struct gpio_dt_spec DHTx =
-    GPIO_DT_SPEC_GET(DT_NODELABEL(dht_pin), gpios);
-
-static struct wlab_buffer TempBuffer = {0}, RhBuffer = {0};
+    "%s,\"name\":\"%s\",\"description\":\"%s\", \"uid\":\"%s\"}";
+
+static int wlab_publish_encode(uint8_t *dst, size_t size, void *user_data);
+static void wlab_publish_done(int result, void *user_data);
+static void wlab_backlog_flush(int64_t timestamp_secs);
+static void wlab_pubs_retry(struct k_work *work);
+static void wlab_samples_drain(void);
+static int64_t wlab_aggregate_task(int64_t due_ms);
+static int64_t wlab_window_task(int64_t due_ms);
+static int64_t wlab_window_next_ms(void);
+static void wlab_window_advance(uint32_t id);
+static uint32_t wlab_period_secs(void);
+static int64_t wlab_diag_task(int64_t due_ms);
+
+/* Diagnostics are published for the first dht sensor, when there is any */
+static const struct device *const Dht =
+    DEVICE_DT_GET_OR_NULL(DT_INST(0, wlab_dht2x));
+
+static struct task_sched_task AggregateTask;
+static struct task_sched_task WindowTask;
+static struct task_sched_task DiagTask;
+static struct dht2x_stats DiagStats; /* snapshot being published */
+static uint32_t DiagTs = 0;
+static atomic_t DiagBusy = ATOMIC_INIT(0);
+static struct wlab_buffer Buffers[WLAB_SERIES_CNT];
+static struct wlab_filter Filters[WLAB_SERIES_CNT];
+static struct wlab_slide Slides[WLAB_SERIES_CNT];
+static K_MUTEX_DEFINE(SlideLock); /* slides are read from shell */
 static char DeviceId[13];
 static uint32_t PublishPeriodMins = 0;
+static uint32_t PayloadFmt = WLAB_CODEC_JSON;
+static struct wlab_record Batch[CONFIG_WLAB_PUB_BATCH_SIZE];
+static atomic_t Authorized = ATOMIC_INIT(0);
+
+/* Samples taken before the first sntp sync, oldest first */
+static struct wlab_acq_sample Unsynced[CONFIG_WLAB_UNSYNCED_SAMPLES_MAX];
+static uint32_t UnsyncedCnt = 0;
+
+/* Tumbling windows are numbered by ts / period, window id N covers epoch
+ * secs [N * period, (N + 1) * period) */
+static uint32_t WindowId = 0; /* open window, 0 - none yet */
+static uint32_t WindowFirstTs = 0;
+static uint32_t WindowLastTs = 0;
+static struct wlab_window_stats WindowStats = {0};
+
+/* Report by exception, the last record stored for publishing and number of
+ * windows suppressed since */
+static struct wlab_record Reported = {0};
+static uint32_t Suppressed = 0;
+
+/* Messages queued for publishing, in order of records in sample log */
+enum wlab_pub_state {
+    WLAB_PUB_QUEUED = 0,
+    WLAB_PUB_ACKED,
+    WLAB_PUB_FAILED,
+};
 
-void wlab_init(void) {
-    int ret = dht2x_init(&DHTx);
-    __ASSERT((0 == ret), "Unable to init dhtx");
+struct wlab_pub {
+    uint32_t off; /* index of the first record in log, set when encoded */
+    uint32_t cnt; /* number of records */
+    enum wlab_pub_state state;
+};
+
+static struct wlab_pub Pubs[CONFIG_MQTT_WORKER_INFLIGHT_MAX];
+static uint32_t PubsHead = 0;
+static uint32_t PubsCnt = 0;
+static uint32_t PubsPlanned = 0; /* records covered by queued messages */
+static uint32_t PubsLost = 0;    /* sample log lost count already rebased */
+static uint32_t BatchCnt = 0;    /* records read into Batch in length pass */
+static uint32_t RetryMs = WLAB_PUB_RETRY_MS_MIN; /* failed messages backoff */
+static K_MUTEX_DEFINE(PubsLock);
+static K_WORK_DELAYABLE_DEFINE(RetryWork, wlab_pubs_retry);
 
-    wlab_buffer_init(&TempBuffer);
-    wlab_buffer_init(&RhBuffer);
+void wlab_init(void) {
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        __ASSERT(device_is_ready(WlabSeries[i].sensor), "%s sensor not ready",
+                 WlabSeries[i].name);
+        wlab_buffer_init(&Buffers[i]);
+        wlab_filter_init(&Filters[i], WlabSeries[i].filter_window);
+        wlab_slide_init(&Slides[i]);
+    }
+    sample_log_init();
     nvs_data_wlab_pub_period_get(&PublishPeriodMins);
+    nvs_data_wlab_payload_fmt_get(&PayloadFmt);
+
+    wlab_acq_start();
+    task_sched_start(&AggregateTask, "wlab_aggregate", wlab_aggregate_task,
+                     k_uptime_get());
+    task_sched_start(&WindowTask, "wlab_window", wlab_window_task,
+                     wlab_window_next_ms());
+#if (0 < CONFIG_WLAB_DIAG_PERIOD_MINS)
+    if (NULL != Dht) {
+        task_sched_start(&DiagTask, "wlab_diag", wlab_diag_task,
+                         k_uptime_get() + 60 * MSEC_PER_SEC);
+    }
+#endif
+}
 
+void wlab_connect(void) {
     uint8_t auth_attempts = 0;
     for (auth_attempts = 0; auth_attempts < 8; auth_attempts++) {
-        wdg_feed();
         if (0 == wlab_authorize()) {
             LOG_INF("wlab authorize success");
             break;
         }
     }
     __ASSERT((auth_attempts < 8), "Unable to init dhtx");
+
+    /* records stored meanwhile are published right away */
+    atomic_set(&Authorized, 1);
+    wlab_alarm_start(DeviceId);
+    wlab_backlog_flush(timestamp_get());
 }
 
-void wlab_process(int64_t timestamp_secs) {
-    static uint32_t last_minutes = 0;
-    static int64_t last_secs = 0;
+/**
+ * @brief Commit values of acquired sample accepted by outlier filter to window
+ * buffers. Serie with failed sensor read is skipped. The first sample past
+ * window boundary closes the open window and is committed to the next one.
+ */
+static void wlab_sample_commit(const struct wlab_acq_sample *sample) {
+    /* sample older than open window, possible only after clock stepped
+     * back, is kept in open window */
+    wlab_window_advance(sample->ts / wlab_period_secs());
+    if (0 == WindowFirstTs) {
+        WindowFirstTs = sample->ts;
+    }
+    WindowLastTs = sample->ts;
 
-    if (timestamp_secs - last_secs < CONFIG_WLAB_MEASURE_PERIOD) {
-        goto process_done;
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        const struct wlab_serie_desc *desc = &WlabSeries[i];
+        int32_t val = sample->val[i];
+        if (0 == (sample->valid & BIT(i))) {
+            continue;
+        }
+        if (!wlab_filter_check(&Filters[i], val, desc->filter_nsigma,
+                               desc->threshold)) {
+            LOG_WRN("%s, value %d rejected as outlier", desc->name, val);
+            continue;
+        }
+        wlab_buffer_commit(&Buffers[i], val, sample->ts, wlab_period_secs());
+        k_mutex_lock(&SlideLock, K_FOREVER);
+        wlab_slide_add(&Slides[i], val, sample->ts);
+        k_mutex_unlock(&SlideLock);
     }
+}
 
-    last_secs = timestamp_secs;
+/**
+ * @brief Commit held unsynced samples once clock is synced, their timestamps
+ * are corrected by the step of the first sync.
+ */
+static void wlab_unsynced_flush(void) {
+    if ((0 == UnsyncedCnt) || !timestamp_synced()) {
+        return;
+    }
 
-    int16_t temp = 0, rh = 0;
-    int32_t temp_avg = 0, rh_avg = 0;
-    int32_t rc = 0;
-    time_t now = 0;
-    struct tm timeinfo = {0};
+    for (uint32_t i = 0; i < UnsyncedCnt; i++) {
+        timestamp_unsynced_correct(&Unsynced[i].ts);
+        wlab_sample_commit(&Unsynced[i]);
+    }
+    LOG_INF("%u samples taken before sync committed", UnsyncedCnt);
+    UnsyncedCnt = 0;
+}
 
-    now = timestamp_secs;
-    gmtime_r(&now, &timeinfo);
+static void wlab_unsynced_hold(const struct wlab_acq_sample *sample) {
+    if (CONFIG_WLAB_UNSYNCED_SAMPLES_MAX == UnsyncedCnt) {
+        LOG_WRN("Clock not synced, sample %u dropped", Unsynced[0].ts);
+        memmove(&Unsynced[0], &Unsynced[1],
+                (UnsyncedCnt - 1) * sizeof(Unsynced[0]));
+        UnsyncedCnt--;
+    }
+    Unsynced[UnsyncedCnt++] = *sample;
+}
 
-    if (0 != dht2x_read(&DHTx, &temp, &rh)) {
-        LOG_ERR("Sensor fetch failed");
-        goto process_done;
+/**
+ * @brief Commit queued samples in order of acquisition. Samples stamped by
+ * unsynced clock are held until the first sync, so no window is built from
+ * estimated time.
+ */
+static void wlab_samples_drain(void) {
+    struct wlab_acq_sample sample;
+
+    wlab_unsynced_flush();
+    while (0 == wlab_acq_get(&sample, K_NO_WAIT)) {
+        if (!sample.synced &&
+            (0 != timestamp_unsynced_correct(&sample.ts))) {
+            wlab_unsynced_hold(&sample);
+            continue;
+        }
+        wlab_unsynced_flush();
+        wlab_sample_commit(&sample);
     }
-    LOG_INF("Temp %d, RH %d", temp, rh);
+}
+
+/**
+ * @brief Aggregate task, commit samples queued by acquisition thread. Samples
+ * carry their own timestamps, so late run of this task does not shift them.
+ */
+static int64_t wlab_aggregate_task(int64_t due_ms) {
+    wlab_samples_drain();
+    return (due_ms + CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC * MSEC_PER_SEC);
+}
 
-    if ((0x00 == timeinfo.tm_min % PublishPeriodMins) &&
-        (timeinfo.tm_min != last_minutes)) {
-        temp_avg = TempBuffer.buff / TempBuffer.cnt;
-        LOG_INF("temp - min: %d max: %d avg: %d", TempBuffer._min,
-                TempBuffer._max, temp_avg);
+static uint32_t wlab_period_secs(void) {
+    return (60 * MAX(PublishPeriodMins, 1));
+}
+
+/**
+ * @brief Uptime millis of the next publish period boundary plus grace time,
+ * boundaries are aligned to epoch. Sample past the boundary normally closes
+ * the window before, task closes it only when acquisition stalls.
+ */
+static int64_t wlab_window_next_ms(void) {
+    int64_t period_ms = wlab_period_secs() * MSEC_PER_SEC;
+    int64_t now_ms = timestamp_get_ms();
+    int64_t boundary_ms = now_ms - (now_ms % period_ms) + period_ms;
 
-        rh_avg = RhBuffer.buff / RhBuffer.cnt;
-        LOG_INF("rh - min: %d max: %d avg: %d", RhBuffer._min, RhBuffer._max,
-                rh_avg);
+    return (k_uptime_get() + (boundary_ms - now_ms) +
+            WLAB_WINDOW_GRACE_SECS * MSEC_PER_SEC);
+}
 
-        LOG_DBG("Sample ready to send...");
-        rc = wlab_dht_publish_sample(&TempBuffer, &RhBuffer);
-        if (0 != rc) {
-            LOG_ERR("%s, publish sample failed rc:%d", __FUNCTION__, rc);
-        } else {
-            LOG_INF("%s, publish sample success", __FUNCTION__);
+#if defined(CONFIG_WLAB_REPORT_BY_EXCEPTION)
+static bool wlab_report_moved(int32_t val, int32_t reported, int32_t band) {
+    return (band < abs(val - reported));
+}
+
+/**
+ * @brief Record is reported when avg, min or max of any serie moved beyond
+ * serie deadband since the last reported record, or when heartbeat period
+ * expired. Empty and partial records are always reported.
+ */
+static bool wlab_report_due(const struct wlab_record *record) {
+    if ((0 != record->flags) || (0 != Reported.flags) ||
+        (0 == Reported.ts) ||
+        (60 * CONFIG_WLAB_HEARTBEAT_MINS <= record->ts - Reported.ts)) {
+        return (true);
+    }
+
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        const struct wlab_record_serie *serie = &record->serie[i];
+        const struct wlab_record_serie *last = &Reported.serie[i];
+        int32_t band = WlabSeries[i].deadband;
+        if (wlab_report_moved(serie->avg, last->avg, band) ||
+            wlab_report_moved(serie->min, last->min, band) ||
+            wlab_report_moved(serie->max, last->max, band)) {
+            return (true);
         }
+    }
+    return (false);
+}
+#endif
 
-        wlab_buffer_init(&TempBuffer);
-        wlab_buffer_init(&RhBuffer);
-        last_minutes = timeinfo.tm_min;
-    } else {
-        wlab_buffer_commit(&TempBuffer, temp, now, 8);
-        wlab_buffer_commit(&RhBuffer, rh, now, 40);
+/**
+ * @brief Store record of open window in sample log and clear window buffers.
+ * Window with no sample of any serie is stored as empty record, window
+ * with serie missing samples or not covered by samples up to its bounds as
+ * partial one.
+ */
+static void wlab_window_close(void) {
+    struct wlab_record record = {0};
+    uint32_t period = wlab_period_secs();
+    bool empty = true, partial = false;
+    int32_t rc = 0;
+
+    record.ts = WindowId * period;
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        empty &= (0 == Buffers[i].cnt);
+        partial |= (0 == Buffers[i].cnt);
+    }
+    partial |= (0 == WindowLastTs) ||
+               (record.ts + WLAB_WINDOW_GRACE_SECS < WindowFirstTs) ||
+               (WindowLastTs + WLAB_WINDOW_GRACE_SECS < record.ts + period);
+
+    WindowStats.closed++;
+    if (empty) {
+        record.flags = WLAB_RECORD_EMPTY;
+        WindowStats.empty++;
+        LOG_WRN("No samples in window %u, empty record", record.ts);
+    } else if (partial) {
+        record.flags = WLAB_RECORD_PARTIAL;
+        WindowStats.partial++;
+        LOG_WRN("Window %u covered %u..%u, partial record", record.ts,
+                WindowFirstTs, WindowLastTs);
+    }
+
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        wlab_buffer_fill(&record.serie[i], &Buffers[i]);
+        LOG_INF("%s - min: %d max: %d avg: %d", WlabSeries[i].name,
+                record.serie[i].min, record.serie[i].max, record.serie[i].avg);
+        wlab_buffer_init(&Buffers[i]);
+    }
+    WindowFirstTs = 0;
+    WindowLastTs = 0;
+
+#if defined(CONFIG_WLAB_REPORT_BY_EXCEPTION)
+    if (!wlab_report_due(&record)) {
+        Suppressed++;
+        WindowStats.suppressed++;
+        LOG_DBG("Window %u within deadband, not reported", record.ts);
+        return;
+    }
+    if (0 < Suppressed) {
+        record.flags |= WLAB_RECORD_FILL;
+    }
+    Suppressed = 0;
+    Reported = record;
+#endif
+
+    LOG_DBG("Sample ready to send...");
+    /* append may overwrite the oldest record, never in the middle of
+     * encoding or acking of queued messages */
+    k_mutex_lock(&PubsLock, K_FOREVER);
+    rc = sample_log_append(&record, sizeof(record));
+    k_mutex_unlock(&PubsLock);
+    if (0 != rc) {
+        LOG_ERR("%s, store sample failed rc:%d", __FUNCTION__, rc);
+    }
+}
+
+/**
+ * @brief Move open window forward to window id. Open window is closed and
+ * every window skipped in between is stored as empty record, up to
+ * WLAB_WINDOW_EMPTY_MAX of them.
+ */
+static void wlab_window_advance(uint32_t id) {
+    if ((0 == WindowId) || (id <= WindowId)) {
+        WindowId = MAX(WindowId, id);
+        return;
+    }
+
+    uint32_t skipped = id - WindowId - 1;
+    wlab_window_close();
+    for (uint32_t i = 0; i < MIN(skipped, WLAB_WINDOW_EMPTY_MAX); i++) {
+        WindowId++;
+        wlab_window_close();
+    }
+    if (WLAB_WINDOW_EMPTY_MAX < skipped) {
+        LOG_WRN("Clock jumped, %u windows without record",
+                skipped - WLAB_WINDOW_EMPTY_MAX);
+    }
+    WindowId = id;
+}
+
+/**
+ * @brief Window task, close open window when no sample past its boundary
+ * came within grace time and publish pending records.
+ */
+static int64_t wlab_window_task(int64_t due_ms) {
+    wlab_samples_drain();
+
+    /* no window is opened before clock is synced */
+    if (timestamp_synced()) {
+        wlab_window_advance(timestamp_get() / wlab_period_secs());
+    }
+
+    wlab_backlog_flush(timestamp_get());
+    return (wlab_window_next_ms());
+}
+
+int wlab_serie_stats_get(uint32_t idx, struct wlab_serie_stats *stats) {
+    if (WLAB_SERIES_CNT <= idx) {
+        return (-ENOENT);
+    }
+
+    stats->name = WlabSeries[idx].name;
+    stats->accepted = Filters[idx].accepted;
+    stats->rejected = Filters[idx].rejected;
+    return (0);
+}
+
+void wlab_window_stats_get(struct wlab_window_stats *stats) {
+    memcpy(stats, &WindowStats, sizeof(struct wlab_window_stats));
+}
+
+int wlab_serie_slide_get(uint32_t idx, struct wlab_slide_value *value) {
+    int ret = 0;
+
+    if (WLAB_SERIES_CNT <= idx) {
+        return (-ENOENT);
     }
 
-process_done:
-    return;
+    k_mutex_lock(&SlideLock, K_FOREVER);
+    ret = wlab_slide_get(&Slides[idx], timestamp_get(), value);
+    k_mutex_unlock(&SlideLock);
+    return (ret);
 }
 
 static void wlab_str_device_id_get(char dst[CONFIG_WLAB_DEVICE_ID_BUFF_LEN]) {
@@ -163,110 +453,333 @@ static void wlab_str_device_id_get(char dst[CONFIG_WLAB_DEVICE_ID_BUFF_LEN]) {
     LOG_INF("Wlab device id: %s", dst);
 }
 
-static int wlab_dht_publish_sample(struct wlab_buffer *temp,
-                                   struct wlab_buffer *rh) {
-    int rc = 0;
+/**
+ * @brief Take records overwritten in full sample log off queued messages,
+ * called with PubsLock held. Overwritten records are the oldest ones, so
+ * they belong to messages at head. Acked message then drops only records it
+ * still owns.
+ */
+static void wlab_pubs_rebase(void) {
+    uint32_t lost = sample_log_lost() - PubsLost;
+    uint32_t start = 0;
 
-    int32_t temp_avg = 0;
-    char tavg_str[8], tact_str[8], tmin_str[8], tmax_str[8];
-    temp_avg = temp->buff / temp->cnt;
-    wlab_itostrf(tavg_str, temp_avg);
-    LOG_DBG("%s, %d [%s]", __FUNCTION__, temp_avg, tavg_str);
-    wlab_itostrf(tact_str, temp->sample_ts_val);
-    wlab_itostrf(tmin_str, temp->_min);
-    wlab_itostrf(tmax_str, temp->_max);
-
-    int32_t rh_avg = 0;
-    char rhavg_str[8], rhact_str[8], rhmin_str[8], rhmax_str[8];
-    rh_avg = rh->buff / rh->cnt;
-    wlab_itostrf(rhavg_str, rh_avg);
-    wlab_itostrf(rhact_str, rh->sample_ts_val);
-    wlab_itostrf(rhmin_str, rh->_min);
-    wlab_itostrf(rhmax_str, rh->_max);
-
-    rc = mqtt_worker_publish_qos1(
-        CONFIG_WLAB_PUB_TOPIC, DHTJsonDataTemplate, DeviceId, temp->sample_ts,
-        tavg_str, tact_str, tmin_str, tmax_str, temp->_min_ts, temp->_max_ts,
-        rhavg_str, rhact_str, rhmin_str, rhmax_str, rh->_min_ts, rh->_max_ts);
-    return (rc);
+    if (0 == lost) {
+        return;
+    }
+
+    PubsLost += lost;
+    for (uint32_t i = 0; i < PubsCnt; i++) {
+        struct wlab_pub *pub =
+            &Pubs[(PubsHead + i) % CONFIG_MQTT_WORKER_INFLIGHT_MAX];
+        uint32_t first = start;
+        start += pub->cnt;
+        pub->cnt -= CLAMP(lost, first, start) - first;
+    }
+    PubsPlanned -= MIN(lost, PubsPlanned);
+    LOG_WRN("%s, %u records lost while queued", __FUNCTION__, lost);
 }
 
-int wlab_authorize(void) {
-    int ret = 0;
-    char station_name[CONFIG_BUFF_MAX_STRING_LEN];
-    struct gps_position position = {0};
+/**
+ * @brief Queue message of sample log records for publishing, called with
+ * PubsLock held.
+ */
+static int wlab_pub_submit(struct wlab_pub *pub) {
+    const struct mqtt_worker_pub_req req = {
+        .topic = (WLAB_CODEC_BIN == PayloadFmt) ? CONFIG_WLAB_PUB_BIN_TOPIC
+                                                : CONFIG_WLAB_PUB_TOPIC,
+        .encode = wlab_publish_encode,
+        .done = wlab_publish_done,
+        .user_data = pub,
+    };
+
+    pub->state = WLAB_PUB_QUEUED;
+    return (mqtt_worker_publish_submit(&req));
+}
 
-    nvs_data_wlab_name_get(station_name);
-    wlab_str_device_id_get(DeviceId);
-    nvs_data_wlab_gps_position_get(&position);
+/**
+ * @brief Publish records stored in sample log, the oldest first. Record is
+ * removed from the log only when broker acked it, so nothing is lost during
+ * broker or wifi outage. Up to CONFIG_WLAB_PUB_BATCH_SIZE records are packed
+ * into one message, partial batch is sent only when the oldest record is
+ * older than CONFIG_WLAB_PUB_BATCH_MAX_AGE_MINS. Up to
+ * CONFIG_MQTT_WORKER_INFLIGHT_MAX messages are queued at once.
+ */
+static void wlab_backlog_flush(int64_t timestamp_secs) {
+    struct wlab_record record = {0};
+    int rc = 0;
 
-    ret = mqtt_worker_publish_qos1(
-        CONFIG_WLAB_AUTH_TOPIC, AuthTemplate, position.timezone,
-        position.latitude, position.longitude, WLAB_TEMP_SERIE,
-        WLAB_HUMIDITY_SERIE, station_name, CONFIG_WLAB_DHT_DESC, DeviceId);
-    return (ret);
+    if (!atomic_get(&Authorized)) {
+        return;
+    }
+
+    k_mutex_lock(&PubsLock, K_FOREVER);
+    wlab_pubs_rebase();
+
+    /* offsets of queued messages would move, drop only when idle */
+    while ((0 == PubsCnt) && (0 < sample_log_count())) {
+        rc = sample_log_peek(0, &record, sizeof(record));
+        if ((int)sizeof(record) == rc) {
+            break;
+        }
+        LOG_ERR("%s, invalid record dropped rc:%d", __FUNCTION__, rc);
+        sample_log_drop(1);
+    }
+
+    while (CONFIG_MQTT_WORKER_INFLIGHT_MAX > PubsCnt) {
+        uint32_t pending = sample_log_count() - PubsPlanned;
+        if (0 == pending) {
+            break;
+        }
+
+        rc = sample_log_peek(PubsPlanned, &record, sizeof(record));
+        if ((CONFIG_WLAB_PUB_BATCH_SIZE > pending) && (0 < rc) &&
+            ((timestamp_secs - record.ts) <
+             (60 * CONFIG_WLAB_PUB_BATCH_MAX_AGE_MINS))) {
+            LOG_DBG("%s, batch not ready %u/%u", __FUNCTION__, pending,
+                    CONFIG_WLAB_PUB_BATCH_SIZE);
+            break;
+        }
+
+        uint32_t idx = (PubsHead + PubsCnt) % CONFIG_MQTT_WORKER_INFLIGHT_MAX;
+        struct wlab_pub *pub = &Pubs[idx];
+        pub->off = 0;
+        pub->cnt = MIN(pending, CONFIG_WLAB_PUB_BATCH_SIZE);
+
+        rc = wlab_pub_submit(pub);
+        if (0 != rc) {
+            LOG_ERR("%s, queue batch failed rc:%d, %u pending", __FUNCTION__,
+                    rc, pending);
+            break;
+        }
+        PubsCnt++;
+        PubsPlanned += pub->cnt;
+    }
+
+    k_mutex_unlock(&PubsLock);
 }
 
-static void wlab_itostrf(char *dst, int32_t signed_int) {
-    if (0 > signed_int) {
-        signed_int = -signed_int;
-        sprintf(dst, "-%d.%d", signed_int / 10, abs(signed_int % 10));
+/**
+ * @brief Encode records of queued message in station payload format, called
+ * by mqtt worker right before message is sent. Length pass (NULL dst) reads
+ * records and trims message to records fitting into size, encode pass
+ * serializes the same records straight into transmit buffer. Records of
+ * message start right after records of messages queued before it, offset is
+ * computed in length pass, once messages ahead of it may be already dropped.
+ */
+static int wlab_publish_encode(uint8_t *dst, size_t size, void *user_data) {
+    struct wlab_pub *pub = user_data;
+    uint32_t idx = pub - Pubs;
+    uint32_t cnt = 0;
+    int rc = 0;
+
+    k_mutex_lock(&PubsLock, K_FOREVER);
+
+    if (NULL != dst) {
+        cnt = BatchCnt;
+        rc = wlab_codec_encode(PayloadFmt, DeviceId, Batch, &cnt, dst, size);
+        goto encode_done;
+    }
+
+    wlab_pubs_rebase();
+
+    /* messages ahead may have been acked and dropped since this one was
+     * queued, records of those still ahead of it are kept in log */
+    pub->off = 0;
+    for (uint32_t i = PubsHead; i != idx;
+         i = (i + 1) % CONFIG_MQTT_WORKER_INFLIGHT_MAX) {
+        pub->off += Pubs[i].cnt;
+    }
+
+    for (cnt = 0; cnt < pub->cnt; cnt++) {
+        rc = sample_log_peek(pub->off + cnt, &Batch[cnt], sizeof(Batch[cnt]));
+        if ((int)sizeof(Batch[cnt]) != rc) {
+            break;
+        }
+    }
+
+    if (0 == cnt) {
+        rc = -ENOENT;
     } else {
-        sprintf(dst, "%d.%d", signed_int / 10, abs(signed_int % 10));
+        rc = wlab_codec_encode(PayloadFmt, DeviceId, Batch, &cnt, NULL, size);
     }
+
+    if (0 > rc) {
+        LOG_ERR("%s, unable to encode sample rc:%d", __FUNCTION__, rc);
+        cnt = 0;
+    }
+
+    /* records which do not fit are left for next message */
+    PubsPlanned -= pub->cnt - cnt;
+    pub->cnt = cnt;
+    BatchCnt = cnt;
+
+encode_done:
+    k_mutex_unlock(&PubsLock);
+    return (rc);
 }
 
-static void wlab_buffer_init(struct wlab_buffer *buffer) {
-    buffer->buff = 0;
-    buffer->cnt = 0;
-    buffer->_max = INT32_MIN;
-    buffer->_min = INT32_MAX;
-    buffer->_max_ts = 0;
-    buffer->_min_ts = 0;
-    buffer->sample_ts_val = INT32_MAX;
-    buffer->sample_ts = 0;
+/**
+ * @brief Publish result, called by mqtt worker. Messages may be acked out of
+ * order, records are removed from the log only for contiguous acked prefix of
+ * queued messages. Acked message behind failed one keeps its records in the
+ * log until then, but is not sent again. Failed message is queued again with
+ * backoff, see wlab_pubs_retry().
+ */
+static void wlab_publish_done(int result, void *user_data) {
+    struct wlab_pub *pub = user_data;
+
+    k_mutex_lock(&PubsLock, K_FOREVER);
+    wlab_pubs_rebase();
+
+    if (0 == result) {
+        LOG_INF("%s, publish %u samples success", __FUNCTION__, pub->cnt);
+        pub->state = WLAB_PUB_ACKED;
+        RetryMs = WLAB_PUB_RETRY_MS_MIN;
+    } else {
+        LOG_ERR("%s, publish batch failed rc:%d, %u pending", __FUNCTION__,
+                result, sample_log_count());
+        /* message left with no records has nothing to retry */
+        pub->state = (0 == pub->cnt) ? WLAB_PUB_ACKED : WLAB_PUB_FAILED;
+    }
+
+    while ((0 < PubsCnt) && (WLAB_PUB_ACKED == Pubs[PubsHead].state)) {
+        uint32_t acked = Pubs[PubsHead].cnt;
+        sample_log_drop(acked);
+        PubsPlanned -= acked;
+        PubsHead = (PubsHead + 1) % CONFIG_MQTT_WORKER_INFLIGHT_MAX;
+        PubsCnt--;
+    }
+
+    if (WLAB_PUB_FAILED == pub->state) {
+        /* no-op when retry is already pending */
+        k_work_schedule(&RetryWork, K_MSEC(RetryMs));
+    }
+
+    k_mutex_unlock(&PubsLock);
+
+    if (0 == result) {
+        wlab_backlog_flush(timestamp_get());
+    }
 }
 
 /**
- * @brief When val exceeds MIN or MAX value more than threshold then skip this
- * measuremnt. It was neccessary to add when pt100 and maxXXXX is a sensor.
+ * @brief Queue failed messages again, with the same records. Backoff doubles
+ * up to WLAB_PUB_RETRY_MS_MAX until a message is acked.
  */
-static bool wlab_buffer_commit(struct wlab_buffer *buffer, int32_t val,
-                               uint32_t ts, uint32_t threshold) {
-    bool rc = false;
-    if (buffer->cnt > 4) {
-        if ((buffer->_max != INT32_MIN) && ((val - threshold) > buffer->_max)) {
-            LOG_ERR("%s, Value %d max exceed threshold", __FUNCTION__, val);
-            goto failed_done;
+static void wlab_pubs_retry(struct k_work *work) {
+    k_mutex_lock(&PubsLock, K_FOREVER);
+
+    for (uint32_t i = 0; i < PubsCnt; i++) {
+        struct wlab_pub *pub =
+            &Pubs[(PubsHead + i) % CONFIG_MQTT_WORKER_INFLIGHT_MAX];
+        if (WLAB_PUB_FAILED != pub->state) {
+            continue;
         }
-
-        if ((buffer->_min != INT32_MAX) && ((val + threshold) < buffer->_min)) {
-            LOG_ERR("%s, Value %d min exceed threshold", __FUNCTION__, val);
-            goto failed_done;
+        if (0 != wlab_pub_submit(pub)) {
+            pub->state = WLAB_PUB_FAILED;
+            k_work_schedule(&RetryWork, K_MSEC(RetryMs));
+            break;
         }
     }
+    RetryMs = MIN(2 * RetryMs, WLAB_PUB_RETRY_MS_MAX);
+
+    k_mutex_unlock(&PubsLock);
+}
+
+static void wlab_diag_put(char *dst, size_t size, size_t *len,
+                          const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool fits = (NULL != dst) && (*len < size);
+    int rc = vsnprintf(fits ? &dst[*len] : NULL, fits ? size - *len : 0, fmt,
+                       args);
+    *len += MAX(rc, 0);
+    va_end(args);
+}
 
-    if (INT32_MAX == buffer->sample_ts_val) {
-        /* Mark buffer timestamp as first sample time */
-        buffer->sample_ts = ts - (ts % (60 * PublishPeriodMins));
-        buffer->sample_ts_val = val;
+static void wlab_diag_put_hist(char *dst, size_t size, size_t *len,
+                               const char *name, const uint32_t *hist,
+                               uint32_t bins) {
+    wlab_diag_put(dst, size, len, ",\"%s\":[", name);
+    for (uint32_t i = 0; i < bins; i++) {
+        wlab_diag_put(dst, size, len, "%s%u", (0 < i) ? "," : "", hist[i]);
     }
+    wlab_diag_put(dst, size, len, "]");
+}
+
+/**
+ * @brief Render DHT read statistics snapshot as json, called by mqtt worker.
+ */
+static int wlab_diag_encode(uint8_t *dst, size_t size, void *user_data) {
+    const struct dht2x_stats *st = &DiagStats;
+    char *out = (char *)dst;
+    size_t len = 0;
+
+    wlab_diag_put(out, size, &len,
+                  "{\"UID\":\"%s\",\"TS\":%u,\"DHT\":{\"reads\":%u,"
+                  "\"timeouts\":%u,\"checksum_errors\":%u,\"recovered\":%u,"
+                  "\"latency_max_us\":%u,\"threshold_us\":%u",
+                  DeviceId, DiagTs, st->reads, st->timeouts,
+                  st->checksum_errors, st->recovered, st->latency_max_us,
+                  st->threshold_us);
+    wlab_diag_put_hist(out, size, &len, "latency_hist", st->latency_hist,
+                       DHT2X_LATENCY_HIST_BINS);
+    wlab_diag_put_hist(out, size, &len, "pulse_hist", st->pulse_hist,
+                       DHT2X_PULSE_HIST_BINS);
+    wlab_diag_put_hist(out, size, &len, "timeout_hist", st->timeout_hist,
+                       DHT2X_TIMEOUT_HIST_BINS);
+    wlab_diag_put(out, size, &len, "}}");
+
+    return ((len < size) ? (int)len : -ENOMEM);
+}
 
-    if (val > buffer->_max) {
-        buffer->_max = val;
-        buffer->_max_ts = ts - (ts % 60);
+static void wlab_diag_done(int result, void *user_data) {
+    if (0 != result) {
+        LOG_WRN("%s, publish diagnostics failed rc:%d", __FUNCTION__, result);
     }
+    atomic_clear(&DiagBusy);
+}
 
-    if (val < buffer->_min) {
-        buffer->_min = val;
-        buffer->_min_ts = ts - (ts % 60);
+/**
+ * @brief Diagnostics task, publish DHT read statistics every
+ * CONFIG_WLAB_DIAG_PERIOD_MINS.
+ */
+static int64_t wlab_diag_task(int64_t due_ms) {
+    const struct mqtt_worker_pub_req req = {
+        .topic = CONFIG_WLAB_DIAG_TOPIC,
+        .encode = wlab_diag_encode,
+        .done = wlab_diag_done,
+    };
+
+    if (atomic_cas(&DiagBusy, 0, 1)) {
+        dht2x_stats_get(Dht, &DiagStats);
+        DiagTs = timestamp_get();
+        if (0 != mqtt_worker_publish_submit(&req)) {
+            atomic_clear(&DiagBusy);
+        }
     }
 
-    buffer->buff += val;
-    buffer->cnt++;
+    return (due_ms + CONFIG_WLAB_DIAG_PERIOD_MINS * 60 * MSEC_PER_SEC);
+}
 
-failed_done:
-    return (rc);
+int wlab_authorize(void) {
+    int ret = 0;
+    char station_name[CONFIG_BUFF_MAX_STRING_LEN];
+    char series[CONFIG_WLAB_AUTH_SERIES_BUFF_LEN];
+    struct gps_position position = {0};
+
+    ret = wlab_codec_auth_series(series, sizeof(series));
+    __ASSERT((0 < ret), "Series do not fit auth message");
+
+    nvs_data_wlab_name_get(station_name);
+    wlab_str_device_id_get(DeviceId);
+    nvs_data_wlab_gps_position_get(&position);
+
+    ret = mqtt_worker_publish_qos1(
+        CONFIG_WLAB_AUTH_TOPIC, AuthTemplate, position.timezone,
+        position.latitude, position.longitude, series, station_name,
+        CONFIG_WLAB_DHT_DESC, DeviceId);
+    return (ret);
 }
 
 /* ---------------------------------------------------------------------------
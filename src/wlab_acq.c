@@ -0,0 +1,232 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_acq.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_acq.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "timestamp.h"
+#include "wlab_alarm.h"
+
+LOG_MODULE_REGISTER(WACQ, LOG_LEVEL_DBG);
+
+#define WLAB_ACQ_STACK_SIZE   (2 * 1024)
+#define WLAB_ACQ_STABLE_CNT   (4) /* flat samples before period doubles */
+#define WLAB_ACQ_NOISE_COUNTS (1) /* change ignored as sensor noise */
+
+BUILD_ASSERT(WLAB_SERIES_CNT <= 32, "Too many series for valid mask");
+
+K_THREAD_STACK_DEFINE(AcqStack, WLAB_ACQ_STACK_SIZE);
+static struct k_thread AcqThread;
+K_TIMER_DEFINE(AcqTimer, NULL, NULL);
+K_MSGQ_DEFINE(AcqQueue, sizeof(struct wlab_acq_sample),
+              CONFIG_WLAB_ACQ_QUEUE_LEN, 4);
+
+static uint32_t PeriodMs = 0;
+
+/* Rate of change of every serie is measured from values at anchor time,
+ * anchor moves whenever period changes, so the baseline spans several
+ * samples and single count noise of a flat signal is not taken as change */
+struct wlab_acq_adapt {
+    int32_t ref[WLAB_SERIES_CNT];
+    uint32_t ref_valid;
+    int64_t ref_ms;
+    uint32_t stable;
+};
+
+static struct wlab_acq_adapt Adapt = {0};
+
+/* Written by acquisition thread only */
+static struct wlab_acq_stats Stats = {0};
+static struct k_spinlock StatsLock;
+
+static uint32_t wlab_acq_hist_bin(uint32_t usecs) {
+    uint32_t bin = 0;
+    while ((WLAB_ACQ_HIST_BINS - 1 > bin) &&
+           ((WLAB_ACQ_HIST_MIN << bin) <= usecs)) {
+        bin++;
+    }
+    return (bin);
+}
+
+/**
+ * @brief Convert sensor api value to 1/scale unit.
+ */
+static int32_t wlab_acq_value_scaled(const struct sensor_value *val,
+                                     uint32_t scale) {
+    return ((int64_t)val->val1 * scale +
+            (int64_t)val->val2 * scale / 1000000);
+}
+
+/**
+ * @brief Read value of every serie in 1/scale unit of the serie. Sensor
+ * delivering more series is fetched only once.
+ */
+static void wlab_acq_read(struct wlab_acq_sample *sample) {
+    int fetch_rc[WLAB_SERIES_CNT];
+
+    sample->ts = timestamp_get_checked(&sample->synced);
+    sample->valid = 0;
+
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        const struct wlab_serie_desc *desc = &WlabSeries[i];
+        struct sensor_value sv = {0};
+        int rc = 0, j = 0;
+
+        while ((j < i) && (WlabSeries[j].sensor != desc->sensor)) {
+            j++;
+        }
+        fetch_rc[i] = (j < i) ? fetch_rc[j] : sensor_sample_fetch(desc->sensor);
+
+        rc = fetch_rc[i];
+        if (0 == rc) {
+            rc = sensor_channel_get(desc->sensor, desc->channel, &sv);
+        }
+        if (0 != rc) {
+            LOG_ERR("%s, sensor read failed rc:%d", desc->name, rc);
+            sample->val[i] = 0;
+            continue;
+        }
+
+        sample->val[i] = wlab_acq_value_scaled(&sv, desc->scale);
+        sample->valid |= BIT(i);
+        LOG_DBG("%s %d", desc->name, sample->val[i]);
+    }
+}
+
+static void wlab_acq_anchor(const struct wlab_acq_sample *sample,
+                            int64_t now_ms) {
+    memcpy(Adapt.ref, sample->val, sizeof(Adapt.ref));
+    Adapt.ref_valid = sample->valid;
+    Adapt.ref_ms = now_ms;
+    Adapt.stable = 0;
+}
+
+/**
+ * @brief Sample period for the next sample. Any serie changing faster than
+ * its adapt rate sets the shortest period at once, period is doubled after
+ * WLAB_ACQ_STABLE_CNT samples with all series flat, up to the longest one.
+ */
+static uint32_t wlab_acq_adapt(const struct wlab_acq_sample *sample,
+                               int64_t now_ms) {
+    uint32_t period_ms = PeriodMs;
+    int64_t dt_ms = MAX(now_ms - Adapt.ref_ms, 1);
+    bool rising = false;
+
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        const struct wlab_serie_desc *desc = &WlabSeries[i];
+        if ((0 == desc->adapt_rate) ||
+            (0 == (sample->valid & Adapt.ref_valid & BIT(i)))) {
+            continue;
+        }
+        /* 1/scale units per minute */
+        int64_t delta = llabs((int64_t)sample->val[i] - Adapt.ref[i]);
+        rising |= (WLAB_ACQ_NOISE_COUNTS < delta) &&
+                  (delta * 60 * MSEC_PER_SEC > desc->adapt_rate * dt_ms);
+    }
+
+    if (rising) {
+        period_ms = CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC * MSEC_PER_SEC;
+        wlab_acq_anchor(sample, now_ms);
+    } else if (WLAB_ACQ_STABLE_CNT <= ++Adapt.stable) {
+        period_ms = MIN(2 * PeriodMs,
+                        CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC * MSEC_PER_SEC);
+        wlab_acq_anchor(sample, now_ms);
+    }
+
+    return (period_ms);
+}
+
+/**
+ * @brief Acquisition thread, timer keeps the cadence independent of read
+ * duration. Jitter is deviation of interval between two samples from
+ * the number of elapsed periods. Alarms are evaluated on raw sample before it
+ * is queued, debounced over consecutive samples. Period adapts to rate of
+ * change of series, timer is restarted only when period changes.
+ */
+static void wlab_acq_proc(void *arg1, void *arg2, void *arg3) {
+    struct wlab_acq_sample sample = {0};
+    int64_t period_us = (int64_t)PeriodMs * USEC_PER_MSEC;
+    int64_t last_us = -1;
+
+    k_timer_start(&AcqTimer, K_NO_WAIT, K_MSEC(PeriodMs));
+
+    while (1) {
+        uint32_t expiries = k_timer_status_sync(&AcqTimer);
+        int64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+        uint32_t start_cyc = k_cycle_get_32();
+
+        wlab_acq_read(&sample);
+
+        uint32_t read_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+        wlab_alarm_check(&sample, now_us);
+        int queued = k_msgq_put(&AcqQueue, &sample, K_NO_WAIT);
+
+        k_spinlock_key_t key = k_spin_lock(&StatsLock);
+        Stats.samples++;
+        Stats.missed += (1 < expiries) ? (expiries - 1) : 0;
+        Stats.dropped += (0 != queued) ? 1 : 0;
+        Stats.read_us_max = MAX(Stats.read_us_max, read_us);
+        if (0 <= last_us) {
+            int64_t jitter_us = now_us - last_us - expiries * period_us;
+            jitter_us = CLAMP(llabs(jitter_us), 0, UINT32_MAX);
+            Stats.jitter_us_max = MAX(Stats.jitter_us_max, (uint32_t)jitter_us);
+            Stats.jitter_hist[wlab_acq_hist_bin(jitter_us)]++;
+        }
+        k_spin_unlock(&StatsLock, key);
+
+        if (0 != queued) {
+            LOG_WRN("Sample queue full, sample %u dropped", sample.ts);
+        }
+        last_us = now_us;
+
+        uint32_t period_ms = wlab_acq_adapt(&sample, now_us / USEC_PER_MSEC);
+        if (period_ms != PeriodMs) {
+            LOG_DBG("Sample period %u ms", period_ms);
+            PeriodMs = period_ms;
+            period_us = (int64_t)PeriodMs * USEC_PER_MSEC;
+            k_timer_start(&AcqTimer, K_MSEC(PeriodMs), K_MSEC(PeriodMs));
+            key = k_spin_lock(&StatsLock);
+            Stats.period_ms = PeriodMs;
+            Stats.period_changes++;
+            k_spin_unlock(&StatsLock, key);
+        }
+    }
+}
+
+void wlab_acq_start(void) {
+    PeriodMs = CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC * MSEC_PER_SEC;
+    Stats.period_ms = PeriodMs;
+
+    k_thread_create(&AcqThread, AcqStack, K_THREAD_STACK_SIZEOF(AcqStack),
+                    wlab_acq_proc, NULL, NULL, NULL,
+                    CONFIG_WLAB_ACQ_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&AcqThread, "wlab_acq");
+    LOG_INF("Acquisition started, period %u..%u s",
+            CONFIG_WLAB_SAMPLE_PERIOD_MIN_SEC,
+            CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC);
+}
+
+int wlab_acq_get(struct wlab_acq_sample *sample, k_timeout_t timeout) {
+    return k_msgq_get(&AcqQueue, sample, timeout);
+}
+
+void wlab_acq_stats_get(struct wlab_acq_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&StatsLock);
+    memcpy(stats, &Stats, sizeof(struct wlab_acq_stats));
+    k_spin_unlock(&StatsLock, key);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,325 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_alarm.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_alarm.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "mqtt_worker.h"
+#include "wlab_codec.h"
+#include "wlab_series.h"
+
+LOG_MODULE_REGISTER(WALARM, LOG_LEVEL_DBG);
+
+#define CONFIG_WLAB_ALARM_TOPIC ("/wlabalarm")
+#define WLAB_ALARM_RATE_SPAN_MS (60 * MSEC_PER_SEC)
+
+BUILD_ASSERT(WLAB_ALARM_KINDS <= 32, "Too many alarm kinds for active mask");
+
+/* Alarm change waiting for PUBACK, owned by mqtt worker until done */
+struct wlab_alarm_event {
+    int64_t read_us;
+    uint32_t ts;
+    int32_t val;
+    int32_t limit;
+    uint8_t serie;
+    uint8_t kind;
+    bool active;
+};
+
+/* Rate is measured against reading at anchor time, anchor moves once it is
+ * WLAB_ALARM_RATE_SPAN_MS old, so a step is seen at once and a slow drift
+ * over the whole span. Alarm state is published whenever it differs from
+ * the last state acked by broker, so change which failed to publish, e.g.
+ * while disconnected, is sent again. State changes only after
+ * CONFIG_WLAB_ALARM_CONFIRM_SAMPLES consecutive samples agree on it. */
+struct wlab_alarm_serie {
+    uint32_t active;
+    uint8_t streak[WLAB_ALARM_KINDS]; /* samples in a row in other state */
+    atomic_t published; /* state acked by broker, written by worker */
+    atomic_t inflight;  /* state change queued or waiting for PUBACK */
+    bool ref_valid;
+    int32_t ref;
+    int64_t ref_ms;
+};
+
+static const char *const KindNames[WLAB_ALARM_KINDS] = {
+    [WLAB_ALARM_HIGH] = "high",
+    [WLAB_ALARM_LOW] = "low",
+    [WLAB_ALARM_RATE] = "rate",
+};
+
+K_MEM_SLAB_DEFINE_STATIC(EventSlab, sizeof(struct wlab_alarm_event),
+                         CONFIG_WLAB_ALARM_QUEUE_LEN, 4);
+
+static atomic_ptr_t Uid = ATOMIC_PTR_INIT(NULL);
+
+/* Written by acquisition thread only */
+static struct wlab_alarm_serie Series[WLAB_SERIES_CNT];
+
+static struct wlab_alarm_stats Stats = {0};
+static struct k_spinlock StatsLock;
+
+void wlab_alarm_start(const char *uid) {
+    atomic_ptr_set(&Uid, (void *)uid);
+}
+
+/**
+ * @brief Render alarm event as json, called by mqtt worker.
+ */
+static int wlab_alarm_encode(uint8_t *dst, size_t size, void *user_data) {
+    const struct wlab_alarm_event *ev = user_data;
+    const struct wlab_serie_desc *desc = &WlabSeries[ev->serie];
+    char val[WLAB_CODEC_NUM_MAX_LEN];
+    char limit[WLAB_CODEC_NUM_MAX_LEN];
+
+    wlab_itostrf(val, ev->val, desc->scale);
+    wlab_itostrf(limit, ev->limit, desc->scale);
+    int len = snprintf((char *)dst, (NULL != dst) ? size : 0,
+                       "{\"UID\":\"%s\",\"TS\":%u,\"SERIE\":\"%s\","
+                       "\"KIND\":\"%s\",\"ACTIVE\":%u,\"VAL\":%s,"
+                       "\"LIMIT\":%s}",
+                       (const char *)atomic_ptr_get(&Uid), ev->ts, desc->name,
+                       KindNames[ev->kind], ev->active ? 1 : 0, val, limit);
+
+    return (((0 <= len) && ((size_t)len < size)) ? len : -ENOMEM);
+}
+
+static void wlab_alarm_done(int result, void *user_data) {
+    struct wlab_alarm_event *ev = user_data;
+    struct wlab_alarm_serie *st = &Series[ev->serie];
+    int64_t latency_us = k_ticks_to_us_floor64(k_uptime_ticks()) - ev->read_us;
+    uint32_t latency_ms = CLAMP(latency_us / USEC_PER_MSEC, 0, UINT32_MAX);
+
+    k_spinlock_key_t key = k_spin_lock(&StatsLock);
+    if (0 == result) {
+        Stats.published++;
+        Stats.latency_ms_last = latency_ms;
+        Stats.latency_ms_max = MAX(Stats.latency_ms_max, latency_ms);
+        Stats.latency_ms_sum += latency_ms;
+    } else {
+        Stats.failed++;
+    }
+    k_spin_unlock(&StatsLock, key);
+
+    if (0 == result) {
+        LOG_INF("%s %s alarm published, latency %u ms",
+                WlabSeries[ev->serie].name, KindNames[ev->kind], latency_ms);
+    } else {
+        LOG_ERR("%s %s alarm not published rc:%d", WlabSeries[ev->serie].name,
+                KindNames[ev->kind], result);
+    }
+
+    if (0 == result) {
+        atomic_set_bit_to(&st->published, ev->kind, ev->active);
+    }
+    atomic_clear_bit(&st->inflight, ev->kind);
+    k_mem_slab_free(&EventSlab, (void *)ev);
+}
+
+static void wlab_alarm_publish(const struct wlab_alarm_event *event) {
+    struct wlab_alarm_serie *st = &Series[event->serie];
+    struct wlab_alarm_event *ev = NULL;
+    struct mqtt_worker_pub_req req = {
+        .topic = CONFIG_WLAB_ALARM_TOPIC,
+        .encode = wlab_alarm_encode,
+        .done = wlab_alarm_done,
+    };
+    int ret = 0;
+
+    atomic_set_bit(&st->inflight, event->kind);
+    ret = k_mem_slab_alloc(&EventSlab, (void **)&ev, K_NO_WAIT);
+    if (0 != ret) {
+        goto publish_done;
+    }
+
+    *ev = *event;
+    req.user_data = ev;
+    ret = mqtt_worker_publish_urgent(&req);
+    if (0 != ret) {
+        k_mem_slab_free(&EventSlab, (void *)ev);
+    }
+
+publish_done:
+    if (0 != ret) {
+        LOG_ERR("%s %s alarm not queued rc:%d", WlabSeries[event->serie].name,
+                KindNames[event->kind], ret);
+        atomic_clear_bit(&st->inflight, event->kind);
+        k_spinlock_key_t key = k_spin_lock(&StatsLock);
+        Stats.failed++;
+        k_spin_unlock(&StatsLock, key);
+    }
+}
+
+/**
+ * @brief Record state of alarm evaluated on sample, alarm changes once the
+ * new state holds for CONFIG_WLAB_ALARM_CONFIRM_SAMPLES samples in a row.
+ */
+static void wlab_alarm_update(const struct wlab_acq_sample *sample,
+                              uint32_t idx, enum wlab_alarm_kind kind,
+                              bool active, int32_t limit) {
+    struct wlab_alarm_serie *st = &Series[idx];
+
+    if (active == (0 != (st->active & BIT(kind)))) {
+        st->streak[kind] = 0;
+        return;
+    }
+    if (CONFIG_WLAB_ALARM_CONFIRM_SAMPLES > ++st->streak[kind]) {
+        return;
+    }
+
+    st->streak[kind] = 0;
+    WRITE_BIT(st->active, kind, active);
+    k_spinlock_key_t key = k_spin_lock(&StatsLock);
+    if (active) {
+        Stats.raised++;
+    } else {
+        Stats.cleared++;
+    }
+    k_spin_unlock(&StatsLock, key);
+
+    LOG_WRN("%s %s alarm %s, value %d limit %d", WlabSeries[idx].name,
+            KindNames[kind], active ? "raised" : "cleared", sample->val[idx],
+            limit);
+}
+
+static int32_t wlab_alarm_limit(const struct wlab_serie_desc *desc,
+                                enum wlab_alarm_kind kind) {
+    switch (kind) {
+        case WLAB_ALARM_HIGH: {
+            return (desc->alarm_high);
+        }
+        case WLAB_ALARM_LOW: {
+            return (desc->alarm_low);
+        }
+        default: {
+            return (desc->alarm_rate);
+        }
+    }
+}
+
+/**
+ * @brief Publish every alarm of serie whose state differs from the last state
+ * acked by broker, unless its previous change is still in flight. Nothing is
+ * queued before start nor without connection, it would be dropped anyway.
+ */
+static void wlab_alarm_sync(const struct wlab_acq_sample *sample,
+                            int64_t read_us, uint32_t idx) {
+    struct wlab_alarm_serie *st = &Series[idx];
+
+    if ((NULL == atomic_ptr_get(&Uid)) || !mqtt_worker_connected()) {
+        return;
+    }
+
+    for (int kind = 0; kind < WLAB_ALARM_KINDS; kind++) {
+        bool active = (0 != (st->active & BIT(kind)));
+        if ((active == atomic_test_bit(&st->published, kind)) ||
+            atomic_test_bit(&st->inflight, kind)) {
+            continue;
+        }
+
+        const struct wlab_alarm_event ev = {
+            .read_us = read_us,
+            .ts = sample->ts,
+            .val = sample->val[idx],
+            .limit = wlab_alarm_limit(&WlabSeries[idx], kind),
+            .serie = idx,
+            .kind = kind,
+            .active = active,
+        };
+        wlab_alarm_publish(&ev);
+    }
+}
+
+/**
+ * @brief Rate alarm, reading moved more than alarm rate per minute since
+ * anchor. Anchor younger than a minute is compared against a full minute
+ * rate, so only a jump larger than the rate itself raises alarm early.
+ */
+static void wlab_alarm_rate_check(const struct wlab_acq_sample *sample,
+                                  int64_t read_us, uint32_t idx) {
+    const struct wlab_serie_desc *desc = &WlabSeries[idx];
+    struct wlab_alarm_serie *st = &Series[idx];
+    int64_t now_ms = read_us / USEC_PER_MSEC;
+    int32_t val = sample->val[idx];
+
+    if (st->ref_valid) {
+        int64_t span_ms = MAX(now_ms - st->ref_ms, WLAB_ALARM_RATE_SPAN_MS);
+        int64_t moved = llabs((int64_t)val - st->ref) * 60 * MSEC_PER_SEC;
+        int64_t rate = desc->alarm_rate;
+        if (0 != (st->active & BIT(WLAB_ALARM_RATE))) {
+            rate = MAX(rate - desc->alarm_hyst, 0);
+        }
+        wlab_alarm_update(sample, idx, WLAB_ALARM_RATE, moved > rate * span_ms,
+                          desc->alarm_rate);
+    }
+
+    if (!st->ref_valid || (WLAB_ALARM_RATE_SPAN_MS <= now_ms - st->ref_ms)) {
+        st->ref_valid = true;
+        st->ref = val;
+        st->ref_ms = now_ms;
+    }
+}
+
+void wlab_alarm_check(const struct wlab_acq_sample *sample, int64_t read_us) {
+    for (uint32_t i = 0; i < WLAB_SERIES_CNT; i++) {
+        const struct wlab_serie_desc *desc = &WlabSeries[i];
+        const struct wlab_alarm_serie *st = &Series[i];
+        int32_t val = sample->val[i];
+        bool active = false;
+
+        if (0 == (sample->valid & BIT(i))) {
+            continue;
+        }
+
+        if (WLAB_SERIE_ALARM_NONE_HIGH != desc->alarm_high) {
+            active = (0 != (st->active & BIT(WLAB_ALARM_HIGH)))
+                         ? (val > desc->alarm_high - desc->alarm_hyst)
+                         : (val >= desc->alarm_high);
+            wlab_alarm_update(sample, i, WLAB_ALARM_HIGH, active,
+                              desc->alarm_high);
+        }
+
+        if (WLAB_SERIE_ALARM_NONE_LOW != desc->alarm_low) {
+            active = (0 != (st->active & BIT(WLAB_ALARM_LOW)))
+                         ? (val < desc->alarm_low + desc->alarm_hyst)
+                         : (val <= desc->alarm_low);
+            wlab_alarm_update(sample, i, WLAB_ALARM_LOW, active,
+                              desc->alarm_low);
+        }
+
+        if (0 != desc->alarm_rate) {
+            wlab_alarm_rate_check(sample, read_us, i);
+        }
+
+        wlab_alarm_sync(sample, read_us, i);
+    }
+}
+
+uint32_t wlab_alarm_active_get(uint32_t idx) {
+    return ((idx < WLAB_SERIES_CNT) ? Series[idx].active : 0);
+}
+
+const char *wlab_alarm_kind_name(enum wlab_alarm_kind kind) {
+    return ((kind < WLAB_ALARM_KINDS) ? KindNames[kind] : "unknown");
+}
+
+void wlab_alarm_stats_get(struct wlab_alarm_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&StatsLock);
+    memcpy(stats, &Stats, sizeof(struct wlab_alarm_stats));
+    k_spin_unlock(&StatsLock, key);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,309 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_bench.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_bench.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "dht2x.h"
+#include "mqtt_worker.h"
+#include "wlab_buffer.h"
+#include "wlab_codec.h"
+#include "wlab_series.h"
+#include "wlab_slide.h"
+
+#define WLAB_BENCH_UID        ("0A1B2C3D4E5F")
+#define WLAB_BENCH_DHT_FRAME  (0x01C200D79AULL) /* 45.0 %RH, 21.5 C */
+#define WLAB_BENCH_STACK_SIZE (2 * 1024)
+#define WLAB_BENCH_PRIORITY   (2)
+
+K_THREAD_STACK_DEFINE(BenchStack, WLAB_BENCH_STACK_SIZE);
+static struct k_thread BenchThread;
+
+static struct wlab_record Records[CONFIG_WLAB_PUB_BATCH_SIZE];
+static struct wlab_buffer Buffer;
+static struct wlab_slide Slide;
+static uint8_t TxBuffer[MQTT_WORKER_MAX_PUBLISH_LEN];
+static uint8_t StagingBuffer[MQTT_WORKER_MAX_PUBLISH_LEN];
+static uint32_t DhtTrace[DHT2X_EDGES_MAX];
+
+static void wlab_bench_records_fill(void) {
+    for (int i = 0; i < CONFIG_WLAB_PUB_BATCH_SIZE; i++) {
+        struct wlab_record *record = &Records[i];
+        record->ts = 1700000000 + 600 * i;
+        for (int j = 0; j < WLAB_SERIES_CNT; j++) {
+            struct wlab_record_serie *serie = &record->serie[j];
+            serie->avg = 215 + 10 * j + i;
+            serie->act = serie->avg + 2;
+            serie->min = serie->avg - 6;
+            serie->max = serie->avg + 5;
+            serie->min_ts = record->ts + 60;
+            serie->max_ts = record->ts + 420;
+            serie->cnt = 150;
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+            serie->std = 12;
+            serie->quantile = serie->avg - 1;
+#endif
+        }
+    }
+}
+
+static int wlab_bench_encode(enum wlab_codec_fmt fmt, uint8_t *dst) {
+    uint32_t cnt = CONFIG_WLAB_PUB_BATCH_SIZE;
+    return wlab_codec_encode(fmt, WLAB_BENCH_UID, Records, &cnt, dst,
+                             MQTT_WORKER_MAX_PUBLISH_LEN);
+}
+
+static int wlab_bench_json_len(void) {
+    return wlab_bench_encode(WLAB_CODEC_JSON, NULL);
+}
+
+static int wlab_bench_json_encode(void) {
+    return wlab_bench_encode(WLAB_CODEC_JSON, TxBuffer);
+}
+
+/* encode into intermediate buffer and copy into transmit buffer, as payloads
+ * were published before encoding straight into transmit buffer */
+static int wlab_bench_json_staged(void) {
+    int len = wlab_bench_encode(WLAB_CODEC_JSON, StagingBuffer);
+    if (0 < len) {
+        memcpy(TxBuffer, StagingBuffer, len);
+    }
+    return (len);
+}
+
+/* number formatted by printf, as wlab_itostrf did before the codec */
+static void wlab_bench_printf_num(char *dst, int32_t val, uint32_t scale) {
+    uint32_t abs_val = (0 > val) ? -(uint32_t)val : val;
+    int frac = 0;
+
+    for (uint32_t div = scale; div > 1; div /= 10) {
+        frac++;
+    }
+
+    if (0 == frac) {
+        snprintf(dst, WLAB_CODEC_NUM_MAX_LEN, "%d", val);
+    } else {
+        snprintf(dst, WLAB_CODEC_NUM_MAX_LEN, "%s%u.%0*u",
+                 (0 > val) ? "-" : "", abs_val / scale, frac,
+                 abs_val % scale);
+    }
+}
+
+static int wlab_bench_printf(char *dst, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(dst, size, fmt, args);
+    va_end(args);
+    return (((0 <= len) && ((size_t)len < size)) ? len : -ENOMEM);
+}
+
+static int wlab_bench_printf_serie(char *dst, size_t size,
+                                   const struct wlab_serie_desc *desc,
+                                   const struct wlab_record_serie *serie) {
+    char avg[WLAB_CODEC_NUM_MAX_LEN], act[WLAB_CODEC_NUM_MAX_LEN];
+    char min[WLAB_CODEC_NUM_MAX_LEN], max[WLAB_CODEC_NUM_MAX_LEN];
+
+    wlab_bench_printf_num(avg, serie->avg, desc->scale);
+    wlab_bench_printf_num(act, serie->act, desc->scale);
+    wlab_bench_printf_num(min, serie->min, desc->scale);
+    wlab_bench_printf_num(max, serie->max, desc->scale);
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    char std[WLAB_CODEC_NUM_MAX_LEN], quantile[WLAB_CODEC_NUM_MAX_LEN];
+    wlab_bench_printf_num(std, serie->std, desc->scale);
+    wlab_bench_printf_num(quantile, serie->quantile, desc->scale);
+    return wlab_bench_printf(
+        dst, size,
+        "\"%s\":{\"f_avg\":%s,\"f_act\":%s,\"f_min\":%s,\"f_max\":%s,"
+        "\"i_min_ts\":%u,\"i_max_ts\":%u,\"i_cnt\":%u,\"f_std\":%s,"
+        "\"f_p%u\":%s}",
+        desc->name, avg, act, min, max, serie->min_ts, serie->max_ts,
+        serie->cnt, std, CONFIG_WLAB_STATS_QUANTILE_PERMILLE / 10, quantile);
+#else
+    return wlab_bench_printf(
+        dst, size,
+        "\"%s\":{\"f_avg\":%s,\"f_act\":%s,\"f_min\":%s,\"f_max\":%s,"
+        "\"i_min_ts\":%u,\"i_max_ts\":%u,\"i_cnt\":%u}",
+        desc->name, avg, act, min, max, serie->min_ts, serie->max_ts,
+        serie->cnt);
+#endif
+}
+
+/* the same payload rendered by printf templates into staging buffer and
+ * copied into transmit buffer, the path used before wlab_codec */
+static int wlab_bench_json_printf(void) {
+    char *dst = (char *)StagingBuffer;
+    size_t size = sizeof(StagingBuffer);
+    bool as_array = (1 < CONFIG_WLAB_PUB_BATCH_SIZE);
+    int len = 0;
+    int ret = 0;
+
+    if (as_array) {
+        dst[len++] = '[';
+    }
+    for (int i = 0; i < CONFIG_WLAB_PUB_BATCH_SIZE; i++) {
+        const struct wlab_record *record = &Records[i];
+        ret = wlab_bench_printf(&dst[len], size - len,
+                                "%s{\"UID\":\"%s\",\"TS\":%u,\"FLAGS\":%u,"
+                                "\"SERIE\":{",
+                                (0 < i) ? "," : "", WLAB_BENCH_UID,
+                                record->ts, record->flags);
+        for (int j = 0; (0 <= ret) && (j < WLAB_SERIES_CNT); j++) {
+            len += ret;
+            if ((0 < j) && (len + 1 < size)) {
+                dst[len++] = ',';
+            }
+            ret = wlab_bench_printf_serie(&dst[len], size - len,
+                                          &WlabSeries[j], &record->serie[j]);
+        }
+        if (0 > ret) {
+            return (ret);
+        }
+        len += ret;
+        ret = wlab_bench_printf(&dst[len], size - len, "}}");
+        if (0 > ret) {
+            return (ret);
+        }
+        len += ret;
+    }
+    if (as_array) {
+        ret = wlab_bench_printf(&dst[len], size - len, "]");
+        if (0 > ret) {
+            return (ret);
+        }
+        len += ret;
+    }
+
+    memcpy(TxBuffer, StagingBuffer, len + 1);
+    return (len);
+}
+
+static int wlab_bench_bin_len(void) {
+    return wlab_bench_encode(WLAB_CODEC_BIN, NULL);
+}
+
+static int wlab_bench_bin_encode(void) {
+    return wlab_bench_encode(WLAB_CODEC_BIN, TxBuffer);
+}
+
+static int wlab_bench_itostrf(void) {
+    char num[WLAB_CODEC_NUM_MAX_LEN];
+    return wlab_itostrf(num, -1234, 10);
+}
+
+static int wlab_bench_buffer_commit(void) {
+    static uint32_t ts = 1700000000;
+    if (0 == (ts % 600)) {
+        wlab_buffer_init(&Buffer);
+    }
+    ts += 4;
+    wlab_buffer_commit(&Buffer, 215 + (ts % 7), ts, 600);
+    return (sizeof(Buffer));
+}
+
+/* value falls over every 600 s and jumps back, so deque push now and then
+ * drops many samples at once, cycles per call show the amortized cost */
+static int wlab_bench_slide_add(void) {
+    static uint32_t ts = 1700000000;
+    ts += 4;
+    wlab_slide_add(&Slide, 215 + (ts % 7) - (ts % 600) / 8, ts);
+    return (sizeof(Slide));
+}
+
+/* edge trace of WLAB_BENCH_DHT_FRAME with nominal sensor timing, sensor
+ * clock running 5 % slow */
+static void wlab_bench_dht_trace_fill(void) {
+    uint32_t t = 30;
+
+    DhtTrace[0] = t;
+    t += 168;
+    for (int i = 0; i < DHT2X_FRAME_BITS; i++) {
+        bool one = WLAB_BENCH_DHT_FRAME & BIT64(DHT2X_FRAME_BITS - 1 - i);
+        DhtTrace[1 + i] = t;
+        t += one ? 126 : 80;
+    }
+    DhtTrace[DHT2X_EDGES_MAX - 1] = t;
+}
+
+static int wlab_bench_dht_decode(void) {
+    struct dht2x_frame_info info = {0};
+    uint64_t frame = 0;
+    int16_t temp = 0, rh = 0;
+
+    int ret = dht2x_frame_decode(DhtTrace, DHT2X_EDGES_MAX, &frame, &info);
+    if (0 != ret) {
+        return (ret);
+    }
+    return dht2x_decode(frame, &temp, &rh);
+}
+
+static const struct {
+    const char *name;
+    int (*fn)(void);
+} Benches[] = {
+    {"json_len", wlab_bench_json_len},
+    {"json_encode", wlab_bench_json_encode},
+    {"json_staged", wlab_bench_json_staged},
+    {"json_printf", wlab_bench_json_printf},
+    {"bin_len", wlab_bench_bin_len},
+    {"bin_encode", wlab_bench_bin_encode},
+    {"itostrf", wlab_bench_itostrf},
+    {"buffer_commit", wlab_bench_buffer_commit},
+    {"slide_add", wlab_bench_slide_add},
+    {"dht_decode", wlab_bench_dht_decode},
+};
+
+/**
+ * @brief Benchmark runs in its own thread on fresh stack, so stack usage of
+ * benchmarked function can be read from untouched part of the stack.
+ */
+static void wlab_bench_proc(void *arg1, void *arg2, void *arg3) {
+    uint32_t idx = (uint32_t)(uintptr_t)arg1;
+    struct wlab_bench_result *res = arg2;
+    int *ret = arg3;
+
+    uint32_t start = k_cycle_get_32();
+    for (int i = 0; i < WLAB_BENCH_ITERATIONS; i++) {
+        *ret = Benches[idx].fn();
+    }
+    res->cycles = (k_cycle_get_32() - start) / WLAB_BENCH_ITERATIONS;
+}
+
+int wlab_bench_run(uint32_t idx, struct wlab_bench_result *res) {
+    size_t unused = 0;
+    int ret = 0;
+
+    if (ARRAY_SIZE(Benches) <= idx) {
+        return (-ENOENT);
+    }
+
+    wlab_bench_records_fill();
+    wlab_bench_dht_trace_fill();
+    wlab_buffer_init(&Buffer);
+    wlab_slide_init(&Slide);
+
+    k_thread_create(&BenchThread, BenchStack,
+                    K_THREAD_STACK_SIZEOF(BenchStack), wlab_bench_proc,
+                    (void *)(uintptr_t)idx, res, &ret, WLAB_BENCH_PRIORITY, 0,
+                    K_NO_WAIT);
+    k_thread_join(&BenchThread, K_FOREVER);
+    k_thread_stack_space_get(&BenchThread, &unused);
+
+    res->name = Benches[idx].name;
+    res->bytes = MAX(ret, 0);
+    res->stack = K_THREAD_STACK_SIZEOF(BenchStack) - unused;
+
+    return (MIN(ret, 0));
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
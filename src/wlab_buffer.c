@@ -0,0 +1,74 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_buffer.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_buffer.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void wlab_buffer_init(struct wlab_buffer *buffer) {
+    buffer->buff = 0;
+    buffer->cnt = 0;
+    buffer->_max = INT32_MIN;
+    buffer->_min = INT32_MAX;
+    buffer->_max_ts = 0;
+    buffer->_min_ts = 0;
+    buffer->sample_ts_val = INT32_MAX;
+    buffer->sample_ts = 0;
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    wlab_stats_var_init(&buffer->var);
+    wlab_stats_p2_init(&buffer->quantile, CONFIG_WLAB_STATS_QUANTILE_PERMILLE);
+#endif
+}
+
+void wlab_buffer_commit(struct wlab_buffer *buffer, int32_t val, uint32_t ts,
+                        uint32_t period_secs) {
+    if (INT32_MAX == buffer->sample_ts_val) {
+        /* Mark buffer timestamp as first sample time */
+        buffer->sample_ts = ts - (ts % period_secs);
+        buffer->sample_ts_val = val;
+    }
+
+    if (val > buffer->_max) {
+        buffer->_max = val;
+        buffer->_max_ts = ts - (ts % 60);
+    }
+
+    if (val < buffer->_min) {
+        buffer->_min = val;
+        buffer->_min_ts = ts - (ts % 60);
+    }
+
+    buffer->buff += val;
+    buffer->cnt++;
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    wlab_stats_var_add(&buffer->var, val);
+    wlab_stats_p2_add(&buffer->quantile, val);
+#endif
+}
+
+void wlab_buffer_fill(struct wlab_record_serie *serie,
+                      const struct wlab_buffer *buffer) {
+    if (0 == buffer->cnt) {
+        memset(serie, 0, sizeof(struct wlab_record_serie));
+        return;
+    }
+
+    serie->avg = buffer->buff / buffer->cnt;
+    serie->act = buffer->sample_ts_val;
+    serie->min = buffer->_min;
+    serie->max = buffer->_max;
+    serie->min_ts = buffer->_min_ts;
+    serie->max_ts = buffer->_max_ts;
+    serie->cnt = buffer->cnt;
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    serie->std = wlab_stats_var_stddev(&buffer->var);
+    serie->quantile = wlab_stats_p2_get(&buffer->quantile);
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,315 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_codec.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_codec.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+LOG_MODULE_REGISTER(WCODEC, LOG_LEVEL_DBG);
+
+#define WLAB_CODEC_BIN_HDR_LEN     (9)
+#define WLAB_CODEC_BIN_REC_HDR_LEN (5)
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+#define WLAB_CODEC_BIN_SERIE_LEN   (18)
+#else
+#define WLAB_CODEC_BIN_SERIE_LEN   (14)
+#endif
+#define WLAB_CODEC_BIN_TS_NONE     (0xFFFF)
+
+/* Json is rendered piece by piece straight into destination buffer. Writer
+ * with NULL destination only counts length, the same code path gives exact
+ * payload length and the payload itself. */
+struct wlab_codec_writer {
+    char *dst;
+    size_t len;
+};
+
+#define WLAB_CODEC_PUT_LIT(w, lit) wlab_codec_put(w, lit, sizeof(lit) - 1)
+
+static void wlab_codec_put(struct wlab_codec_writer *w, const char *src,
+                           size_t n) {
+    if (NULL != w->dst) {
+        memcpy(&w->dst[w->len], src, n);
+    }
+    w->len += n;
+}
+
+static int wlab_codec_utostrf(char *dst, uint32_t val, int frac);
+
+static void wlab_codec_put_str(struct wlab_codec_writer *w, const char *str) {
+    wlab_codec_put(w, str, strlen(str));
+}
+
+static void wlab_codec_put_num(struct wlab_codec_writer *w, int32_t val,
+                               uint32_t scale) {
+    char num[WLAB_CODEC_NUM_MAX_LEN];
+    wlab_codec_put(w, num, wlab_itostrf(num, val, scale));
+}
+
+static void wlab_codec_put_u32(struct wlab_codec_writer *w, uint32_t val) {
+    char num[WLAB_CODEC_NUM_MAX_LEN];
+    wlab_codec_put(w, num, wlab_codec_utostrf(num, val, 0));
+}
+
+static void wlab_codec_json_serie(struct wlab_codec_writer *w,
+                                  const struct wlab_serie_desc *desc,
+                                  const struct wlab_record_serie *serie) {
+    WLAB_CODEC_PUT_LIT(w, "\"");
+    wlab_codec_put_str(w, desc->name);
+    WLAB_CODEC_PUT_LIT(w, "\":{\"f_avg\":");
+    wlab_codec_put_num(w, serie->avg, desc->scale);
+    WLAB_CODEC_PUT_LIT(w, ",\"f_act\":");
+    wlab_codec_put_num(w, serie->act, desc->scale);
+    WLAB_CODEC_PUT_LIT(w, ",\"f_min\":");
+    wlab_codec_put_num(w, serie->min, desc->scale);
+    WLAB_CODEC_PUT_LIT(w, ",\"f_max\":");
+    wlab_codec_put_num(w, serie->max, desc->scale);
+    WLAB_CODEC_PUT_LIT(w, ",\"i_min_ts\":");
+    wlab_codec_put_u32(w, serie->min_ts);
+    WLAB_CODEC_PUT_LIT(w, ",\"i_max_ts\":");
+    wlab_codec_put_u32(w, serie->max_ts);
+    WLAB_CODEC_PUT_LIT(w, ",\"i_cnt\":");
+    wlab_codec_put_u32(w, serie->cnt);
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    /* quantile field name depends on configured quantile, e.g. f_p50 for
+     * median */
+    WLAB_CODEC_PUT_LIT(w, ",\"f_std\":");
+    wlab_codec_put_num(w, serie->std, desc->scale);
+    WLAB_CODEC_PUT_LIT(w, ",\"f_p");
+    wlab_codec_put_u32(w, CONFIG_WLAB_STATS_QUANTILE_PERMILLE / 10);
+    WLAB_CODEC_PUT_LIT(w, "\":");
+    wlab_codec_put_num(w, serie->quantile, desc->scale);
+#endif
+    WLAB_CODEC_PUT_LIT(w, "}");
+}
+
+static void wlab_codec_json_record(struct wlab_codec_writer *w,
+                                   const char *uid,
+                                   const struct wlab_record *record) {
+    WLAB_CODEC_PUT_LIT(w, "{\"UID\":\"");
+    wlab_codec_put_str(w, uid);
+    WLAB_CODEC_PUT_LIT(w, "\",\"TS\":");
+    wlab_codec_put_u32(w, record->ts);
+    WLAB_CODEC_PUT_LIT(w, ",\"FLAGS\":");
+    wlab_codec_put_u32(w, record->flags);
+    WLAB_CODEC_PUT_LIT(w, ",\"SERIE\":{");
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        if (0 < i) {
+            WLAB_CODEC_PUT_LIT(w, ",");
+        }
+        wlab_codec_json_serie(w, &WlabSeries[i], &record->serie[i]);
+    }
+    WLAB_CODEC_PUT_LIT(w, "}}");
+}
+
+/**
+ * @brief With CONFIG_WLAB_PUB_BATCH_SIZE 1 record is sent as plain json
+ * object, otherwise records are always sent as json array of objects. Framing
+ * does not depend on number of records, so length pass trimming records gives
+ * the same payload as encode pass of trimmed records.
+ */
+static int wlab_codec_json_encode(const char *uid,
+                                  const struct wlab_record *records,
+                                  uint32_t *cnt, uint8_t *dst, size_t size) {
+    struct wlab_codec_writer w = {.dst = (char *)dst, .len = 0};
+    bool as_array = (1 < CONFIG_WLAB_PUB_BATCH_SIZE);
+    uint32_t max = as_array ? *cnt : MIN(*cnt, 1);
+    uint32_t idx = 0;
+
+    if (as_array) {
+        WLAB_CODEC_PUT_LIT(&w, "[");
+    }
+
+    for (idx = 0; idx < max; idx++) {
+        struct wlab_codec_writer probe = {.dst = NULL, .len = 0};
+        wlab_codec_json_record(&probe, uid, &records[idx]);
+
+        /* keep place for separator, closing bracket and \0 */
+        size_t sep = (0 < idx) ? 1 : 0;
+        if (size <= w.len + sep + probe.len + (as_array ? 1 : 0)) {
+            break;
+        }
+
+        if (sep) {
+            WLAB_CODEC_PUT_LIT(&w, ",");
+        }
+        wlab_codec_json_record(&w, uid, &records[idx]);
+    }
+
+    if (0 == idx) {
+        return (-ENOMEM);
+    }
+
+    if (as_array) {
+        WLAB_CODEC_PUT_LIT(&w, "]");
+    }
+    if (NULL != dst) {
+        dst[w.len] = '\0';
+    }
+
+    *cnt = idx;
+    return (w.len);
+}
+
+static uint16_t wlab_codec_bin_ts(uint32_t ts, uint32_t base) {
+    if ((0 == ts) || (ts < base)) {
+        return (WLAB_CODEC_BIN_TS_NONE);
+    }
+    return MIN(ts - base, WLAB_CODEC_BIN_TS_NONE - 1);
+}
+
+static uint8_t *wlab_codec_bin_serie(uint8_t *out,
+                                     const struct wlab_record_serie *serie,
+                                     uint32_t base) {
+    sys_put_le16((int16_t)serie->avg, &out[0]);
+    sys_put_le16((int16_t)serie->act, &out[2]);
+    sys_put_le16((int16_t)serie->min, &out[4]);
+    sys_put_le16((int16_t)serie->max, &out[6]);
+    sys_put_le16(wlab_codec_bin_ts(serie->min_ts, base), &out[8]);
+    sys_put_le16(wlab_codec_bin_ts(serie->max_ts, base), &out[10]);
+    sys_put_le16(MIN(serie->cnt, UINT16_MAX), &out[12]);
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+    sys_put_le16(MIN(serie->std, UINT16_MAX), &out[14]);
+    sys_put_le16((int16_t)serie->quantile, &out[16]);
+#endif
+    return (out + WLAB_CODEC_BIN_SERIE_LEN);
+}
+
+static int wlab_codec_bin_encode(const char *uid,
+                                 const struct wlab_record *records,
+                                 uint32_t *cnt, uint8_t *dst, size_t size) {
+    const size_t hdr_len = WLAB_CODEC_BIN_HDR_LEN + WLAB_SERIES_CNT;
+    const size_t rec_len =
+        WLAB_CODEC_BIN_REC_HDR_LEN + WLAB_SERIES_CNT * WLAB_CODEC_BIN_SERIE_LEN;
+
+    uint32_t fits = MIN(*cnt, UINT8_MAX);
+    if (size < hdr_len + rec_len) {
+        return (-ENOMEM);
+    }
+    fits = MIN(fits, (size - hdr_len) / rec_len);
+    if (NULL == dst) {
+        *cnt = fits;
+        return (hdr_len + fits * rec_len);
+    }
+
+    uint64_t uid_val = strtoull(uid, NULL, 16);
+    dst[0] = WLAB_CODEC_BIN_VERSION;
+    dst[1] = fits;
+    for (int i = 0; i < 6; i++) {
+        dst[2 + i] = (uid_val >> (8 * (5 - i))) & 0xFF;
+    }
+    dst[8] = WLAB_SERIES_CNT;
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        dst[WLAB_CODEC_BIN_HDR_LEN + i] = WlabSeries[i].id;
+    }
+
+    uint8_t *out = dst + hdr_len;
+    for (uint32_t idx = 0; idx < fits; idx++) {
+        const struct wlab_record *record = &records[idx];
+        sys_put_le32(record->ts, out);
+        out[4] = record->flags;
+        out += WLAB_CODEC_BIN_REC_HDR_LEN;
+        for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+            out = wlab_codec_bin_serie(out, &record->serie[i], record->ts);
+        }
+    }
+
+    *cnt = fits;
+    return (out - dst);
+}
+
+int wlab_codec_encode(enum wlab_codec_fmt fmt, const char *uid,
+                      const struct wlab_record *records, uint32_t *cnt,
+                      uint8_t *dst, size_t size) {
+    int ret = 0;
+
+    switch (fmt) {
+        case WLAB_CODEC_JSON: {
+            ret = wlab_codec_json_encode(uid, records, cnt, dst, size);
+            break;
+        }
+        case WLAB_CODEC_BIN: {
+            ret = wlab_codec_bin_encode(uid, records, cnt, dst, size);
+            break;
+        }
+        default: {
+            LOG_ERR("Unknown payload format %d", fmt);
+            ret = -ENOTSUP;
+            break;
+        }
+    }
+
+    return (ret);
+}
+
+int wlab_codec_auth_series(char *dst, size_t size) {
+    size_t len = 0;
+    int rc = 0;
+
+    for (int i = 0; i < WLAB_SERIES_CNT; i++) {
+        rc = snprintf(&dst[len], size - len, "%s\"%s\":%u", (0 < i) ? "," : "{",
+                      WlabSeries[i].name, WlabSeries[i].id);
+        if ((0 > rc) || (size - len <= (size_t)rc)) {
+            return (-ENOMEM);
+        }
+        len += rc;
+    }
+
+    if (size <= len + 1) {
+        return (-ENOMEM);
+    }
+    dst[len++] = '}';
+    dst[len] = '\0';
+
+    return (len);
+}
+
+/**
+ * @brief Format unsigned value with given number of fraction digits.
+ */
+static int wlab_codec_utostrf(char *dst, uint32_t val, int frac) {
+    char digit[10];
+    int n = 0, len = 0;
+
+    /* at least one integer digit, fraction padded with zeros */
+    do {
+        digit[n++] = '0' + (val % 10);
+        val /= 10;
+    } while ((0 < val) || (n <= frac));
+
+    while (n--) {
+        dst[len++] = digit[n];
+        if ((n == frac) && (0 < frac)) {
+            dst[len++] = '.';
+        }
+    }
+    dst[len] = '\0';
+
+    return (len);
+}
+
+int wlab_itostrf(char *dst, int32_t signed_int, uint32_t scale) {
+    uint32_t abs_int = (0 > signed_int) ? -(uint32_t)signed_int : signed_int;
+    int frac = 0;
+
+    for (uint32_t div = scale; div > 1; div /= 10) {
+        frac++;
+    }
+
+    if (0 > signed_int) {
+        *dst = '-';
+        return (1 + wlab_codec_utostrf(dst + 1, abs_int, frac));
+    }
+    return (wlab_codec_utostrf(dst, abs_int, frac));
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
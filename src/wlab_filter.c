@@ -0,0 +1,77 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_filter.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_filter.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+/* MAD to standard deviation factor for normal distribution, 1.4826 */
+#define WLAB_FILTER_MAD_SCALE     (14826)
+#define WLAB_FILTER_MAD_SCALE_DIV (10000)
+#define WLAB_FILTER_MIN_READINGS  (3)
+
+static int32_t wlab_filter_median(int32_t *vals, uint32_t cnt) {
+    for (uint32_t i = 1; i < cnt; i++) {
+        int32_t val = vals[i];
+        int j = i - 1;
+        while ((0 <= j) && (vals[j] > val)) {
+            vals[j + 1] = vals[j];
+            j--;
+        }
+        vals[j + 1] = val;
+    }
+
+    if (cnt & 1) {
+        return (vals[cnt / 2]);
+    }
+    return ((vals[cnt / 2 - 1] + vals[cnt / 2]) / 2);
+}
+
+void wlab_filter_init(struct wlab_filter *filter, uint32_t window) {
+    memset(filter, 0x00, sizeof(struct wlab_filter));
+    filter->size = CLAMP(window, 1, CONFIG_WLAB_FILTER_WINDOW_MAX);
+}
+
+bool wlab_filter_check(struct wlab_filter *filter, int32_t val,
+                       uint32_t nsigma_x10, int32_t min_tolerance) {
+    int32_t tmp[CONFIG_WLAB_FILTER_WINDOW_MAX];
+    bool accept = true;
+
+    filter->ring[filter->head] = val;
+    filter->head = (filter->head + 1) % filter->size;
+    filter->cnt = MIN(filter->cnt + 1, filter->size);
+
+    if (WLAB_FILTER_MIN_READINGS > filter->cnt) {
+        goto check_done;
+    }
+
+    memcpy(tmp, filter->ring, filter->cnt * sizeof(int32_t));
+    int32_t median = wlab_filter_median(tmp, filter->cnt);
+
+    for (uint32_t i = 0; i < filter->cnt; i++) {
+        tmp[i] = abs(filter->ring[i] - median);
+    }
+    int32_t mad = wlab_filter_median(tmp, filter->cnt);
+
+    int64_t tolerance = (int64_t)mad * nsigma_x10 * WLAB_FILTER_MAD_SCALE /
+                        (10 * WLAB_FILTER_MAD_SCALE_DIV);
+    tolerance = MAX(tolerance, min_tolerance);
+    accept = (abs(val - median) <= tolerance);
+
+check_done:
+    if (accept) {
+        filter->accepted++;
+    } else {
+        filter->rejected++;
+    }
+    return (accept);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,42 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_series.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_series.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/sys/util.h>
+
+BUILD_ASSERT(DT_NODE_HAS_STATUS(WLAB_SERIES_NODE, okay),
+             "wlab_series node missing in devicetree");
+BUILD_ASSERT(0 < WLAB_SERIES_CNT, "No wlab serie enabled");
+
+#define WLAB_SERIE_DESC(node)                                                  \
+    {                                                                          \
+        .id = DT_PROP(node, serie_id),                                         \
+        .name = DT_PROP(node, serie_name),                                     \
+        .sensor = DEVICE_DT_GET(DT_PHANDLE(node, sensor)),                     \
+        .channel =                                                             \
+            UTIL_CAT(SENSOR_CHAN_, DT_STRING_UPPER_TOKEN(node, channel)),      \
+        .scale = DT_PROP(node, scale),                                         \
+        .threshold = DT_PROP(node, outlier_threshold),                         \
+        .filter_window = DT_PROP(node, filter_window),                         \
+        .filter_nsigma = DT_PROP(node, filter_nsigma),                         \
+        .adapt_rate = DT_PROP(node, adapt_rate),                               \
+        .deadband = DT_PROP(node, deadband),                                   \
+        .alarm_high =                                                          \
+            DT_PROP_OR(node, alarm_high, WLAB_SERIE_ALARM_NONE_HIGH),          \
+        .alarm_low = DT_PROP_OR(node, alarm_low, WLAB_SERIE_ALARM_NONE_LOW),   \
+        .alarm_hyst = DT_PROP(node, alarm_hysteresis),                         \
+        .alarm_rate = DT_PROP(node, alarm_rate),                               \
+    },
+
+const struct wlab_serie_desc WlabSeries[] = {
+    DT_FOREACH_CHILD_STATUS_OKAY(WLAB_SERIES_NODE, WLAB_SERIE_DESC)};
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,111 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_slide.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_slide.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t wlab_slide_slot(uint32_t seq) {
+    return (seq % WLAB_SLIDE_LEN);
+}
+
+static uint32_t wlab_slide_deque_front(const struct wlab_slide_deque *dq) {
+    return (dq->seq[wlab_slide_slot(dq->front)]);
+}
+
+static uint32_t wlab_slide_deque_back(const struct wlab_slide_deque *dq) {
+    return (dq->seq[wlab_slide_slot(dq->back - 1)]);
+}
+
+/**
+ * @brief Push sample to deque back, dropping samples which can never become
+ * window extreme, older and not better than the new one.
+ */
+static void wlab_slide_deque_push(struct wlab_slide_deque *dq,
+                                  const int32_t *val, uint32_t seq,
+                                  bool is_min) {
+    int32_t new_val = val[wlab_slide_slot(seq)];
+
+    while (dq->front != dq->back) {
+        int32_t back_val = val[wlab_slide_slot(wlab_slide_deque_back(dq))];
+        if (is_min ? (back_val < new_val) : (back_val > new_val)) {
+            break;
+        }
+        dq->back--;
+    }
+    dq->seq[wlab_slide_slot(dq->back++)] = seq;
+}
+
+static void wlab_slide_evict_oldest(struct wlab_slide *slide) {
+    slide->sum -= slide->val[wlab_slide_slot(slide->tail)];
+
+    if ((slide->min.front != slide->min.back) &&
+        (slide->tail == wlab_slide_deque_front(&slide->min))) {
+        slide->min.front++;
+    }
+    if ((slide->max.front != slide->max.back) &&
+        (slide->tail == wlab_slide_deque_front(&slide->max))) {
+        slide->max.front++;
+    }
+    slide->tail++;
+}
+
+static void wlab_slide_evict(struct wlab_slide *slide, uint32_t ts) {
+    while ((slide->tail != slide->head) &&
+           (slide->ts[wlab_slide_slot(slide->tail)] +
+                CONFIG_WLAB_SLIDE_WINDOW_SECS <=
+            ts)) {
+        wlab_slide_evict_oldest(slide);
+    }
+}
+
+void wlab_slide_init(struct wlab_slide *slide) {
+    memset(slide, 0, sizeof(struct wlab_slide));
+}
+
+void wlab_slide_add(struct wlab_slide *slide, int32_t val, uint32_t ts) {
+    wlab_slide_evict(slide, ts);
+    if (WLAB_SLIDE_LEN == (slide->head - slide->tail)) {
+        wlab_slide_evict_oldest(slide);
+    }
+
+    uint32_t slot = wlab_slide_slot(slide->head);
+    slide->val[slot] = val;
+    slide->ts[slot] = ts;
+    slide->sum += val;
+
+    wlab_slide_deque_push(&slide->min, slide->val, slide->head, true);
+    wlab_slide_deque_push(&slide->max, slide->val, slide->head, false);
+    slide->head++;
+}
+
+int wlab_slide_get(struct wlab_slide *slide, uint32_t ts,
+                   struct wlab_slide_value *value) {
+    wlab_slide_evict(slide, ts);
+
+    uint32_t cnt = slide->head - slide->tail;
+    if (0 == cnt) {
+        return (-ENODATA);
+    }
+
+    uint32_t min_slot = wlab_slide_slot(wlab_slide_deque_front(&slide->min));
+    uint32_t max_slot = wlab_slide_slot(wlab_slide_deque_front(&slide->max));
+
+    value->avg = slide->sum / cnt;
+    value->min = slide->val[min_slot];
+    value->max = slide->val[max_slot];
+    value->min_ts = slide->ts[min_slot];
+    value->max_ts = slide->ts[max_slot];
+    value->cnt = cnt;
+    value->first_ts = slide->ts[wlab_slide_slot(slide->tail)];
+    return (0);
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,206 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: wlab_stats.c
+ * --------------------------------------------------------------------------*/
+#include "wlab_stats.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define WLAB_STATS_Q8  (8)
+#define WLAB_STATS_Q16 (16)
+
+static int32_t wlab_stats_round_shift(int64_t val, uint32_t shift) {
+    return ((val + (1LL << (shift - 1))) >> shift);
+}
+
+static uint32_t wlab_stats_isqrt(uint64_t val) {
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > val) {
+        bit >>= 2;
+    }
+
+    while (0 != bit) {
+        if (val >= res + bit) {
+            val -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (res);
+}
+
+void wlab_stats_var_init(struct wlab_stats_var *var) {
+    var->n = 0;
+    var->mean = 0;
+    var->m2 = 0;
+}
+
+void wlab_stats_var_add(struct wlab_stats_var *var, int32_t val) {
+    /* samples go below zero, left shift of negative value is undefined */
+    int64_t x = (int64_t)val * (1 << WLAB_STATS_Q16);
+
+    var->n++;
+    int64_t delta = x - var->mean;
+    var->mean += delta / (int64_t)var->n;
+    int64_t delta2 = x - var->mean;
+    var->m2 += (delta * delta2) >> WLAB_STATS_Q16;
+}
+
+int32_t wlab_stats_var_stddev(const struct wlab_stats_var *var) {
+    if (2 > var->n) {
+        return (0);
+    }
+
+    /* sqrt of Q16 variance gives Q8 standard deviation */
+    int64_t variance = var->m2 / (int64_t)(var->n - 1);
+    uint32_t stddev = wlab_stats_isqrt((0 > variance) ? 0 : variance);
+    return (wlab_stats_round_shift(stddev, WLAB_STATS_Q8));
+}
+
+void wlab_stats_p2_init(struct wlab_stats_p2 *p2, uint32_t permille) {
+    memset(p2, 0x00, sizeof(struct wlab_stats_p2));
+    p2->p = permille;
+}
+
+static int64_t wlab_stats_p2_rate(const struct wlab_stats_p2 *p2, int marker) {
+    /* desired position increments: 0, p/2, p, (1+p)/2, 1 */
+    static const int32_t p_mul[WLAB_STATS_P2_MARKERS] = {0, 1, 2, 1, 0};
+    static const int32_t one_mul[WLAB_STATS_P2_MARKERS] = {0, 0, 0, 1, 2};
+
+    int64_t p = ((int64_t)p2->p << WLAB_STATS_Q16) / 1000;
+    return ((p_mul[marker] * p + (one_mul[marker] << WLAB_STATS_Q16)) / 2);
+}
+
+static void wlab_stats_p2_start(struct wlab_stats_p2 *p2) {
+    /* sort first five samples, insertion sort */
+    for (int i = 1; i < WLAB_STATS_P2_MARKERS; i++) {
+        int32_t q = p2->q[i];
+        int j = i - 1;
+        while ((0 <= j) && (p2->q[j] > q)) {
+            p2->q[j + 1] = p2->q[j];
+            j--;
+        }
+        p2->q[j + 1] = q;
+    }
+
+    for (int i = 0; i < WLAB_STATS_P2_MARKERS; i++) {
+        p2->pos[i] = i + 1;
+        p2->want[i] = (1LL << WLAB_STATS_Q16) + 4 * wlab_stats_p2_rate(p2, i);
+    }
+}
+
+static int32_t wlab_stats_p2_parabolic(const struct wlab_stats_p2 *p2, int i,
+                                       int32_t d) {
+    const int32_t *q = p2->q;
+    const int32_t *n = p2->pos;
+
+    int64_t a = (int64_t)(n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) /
+                (n[i + 1] - n[i]);
+    int64_t b = (int64_t)(n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) /
+                (n[i] - n[i - 1]);
+    return (q[i] + d * (a + b) / (n[i + 1] - n[i - 1]));
+}
+
+static int32_t wlab_stats_p2_linear(const struct wlab_stats_p2 *p2, int i,
+                                    int32_t d) {
+    const int32_t *q = p2->q;
+    const int32_t *n = p2->pos;
+
+    return (q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]));
+}
+
+void wlab_stats_p2_add(struct wlab_stats_p2 *p2, int32_t val) {
+    int32_t x = val * (1 << WLAB_STATS_Q8);
+    int k = 0;
+
+    if (WLAB_STATS_P2_MARKERS > p2->n) {
+        p2->q[p2->n++] = x;
+        if (WLAB_STATS_P2_MARKERS == p2->n) {
+            wlab_stats_p2_start(p2);
+        }
+        return;
+    }
+
+    p2->n++;
+
+    /* find cell k such that q[k] <= x < q[k+1], adjust extremes */
+    if (x < p2->q[0]) {
+        p2->q[0] = x;
+        k = 0;
+    } else if (x >= p2->q[4]) {
+        p2->q[4] = x;
+        k = 3;
+    } else {
+        for (k = 0; k < 3; k++) {
+            if (x < p2->q[k + 1]) {
+                break;
+            }
+        }
+    }
+
+    for (int i = k + 1; i < WLAB_STATS_P2_MARKERS; i++) {
+        p2->pos[i]++;
+    }
+    for (int i = 0; i < WLAB_STATS_P2_MARKERS; i++) {
+        p2->want[i] += wlab_stats_p2_rate(p2, i);
+    }
+
+    /* adjust heights of middle markers if they are off desired position */
+    for (int i = 1; i < WLAB_STATS_P2_MARKERS - 1; i++) {
+        int64_t d = p2->want[i] - ((int64_t)p2->pos[i] << WLAB_STATS_Q16);
+        bool move_up = (d >= (1LL << WLAB_STATS_Q16)) &&
+                       (1 < (p2->pos[i + 1] - p2->pos[i]));
+        bool move_down = (d <= -(1LL << WLAB_STATS_Q16)) &&
+                         (-1 > (p2->pos[i - 1] - p2->pos[i]));
+        if (!move_up && !move_down) {
+            continue;
+        }
+
+        int32_t ds = move_up ? 1 : -1;
+        int32_t q = wlab_stats_p2_parabolic(p2, i, ds);
+        if ((p2->q[i - 1] < q) && (q < p2->q[i + 1])) {
+            p2->q[i] = q;
+        } else {
+            p2->q[i] = wlab_stats_p2_linear(p2, i, ds);
+        }
+        p2->pos[i] += ds;
+    }
+}
+
+int32_t wlab_stats_p2_get(const struct wlab_stats_p2 *p2) {
+    if (0 == p2->n) {
+        return (0);
+    }
+
+    if (WLAB_STATS_P2_MARKERS <= p2->n) {
+        return (wlab_stats_round_shift(p2->q[2], WLAB_STATS_Q8));
+    }
+
+    /* not enough samples for estimation, take exact quantile */
+    int32_t sorted[WLAB_STATS_P2_MARKERS];
+    memcpy(sorted, p2->q, p2->n * sizeof(int32_t));
+    for (uint32_t i = 1; i < p2->n; i++) {
+        int32_t q = sorted[i];
+        int j = i - 1;
+        while ((0 <= j) && (sorted[j] > q)) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = q;
+    }
+
+    uint32_t idx = ((p2->n - 1) * p2->p + 500) / 1000;
+    return (wlab_stats_round_shift(sorted[idx], WLAB_STATS_Q8));
+}
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,229 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "dht2x.h"
+
+#define TEST_FRAME     (0x01C200D79AULL) /* 45.0 %RH, 21.5 C */
+#define TEST_FRAME_NEG (0x0190806576ULL) /* 40.0 %RH, -10.1 C */
+#define TEST_FRAME_BAD (0x01C200D79BULL) /* checksum mismatch */
+#define TEST_FRAME_TIMEOUT_MS                                                  \
+    DT_PROP(DT_NODELABEL(dht0), frame_timeout_ms)
+
+#define TEST_SENSOR_STACK_SIZE (1024)
+#define TEST_SENSOR_PRIORITY   (K_PRIO_PREEMPT(1))
+
+struct test_sensor {
+    const struct gpio_dt_spec *dio;
+    uint64_t frame;
+    uint32_t clock_pct; /* sensor clock deviation, 0 - sensor is silent */
+};
+
+static const struct device *const Dht0 = DEVICE_DT_GET(DT_NODELABEL(dht0));
+static const struct device *const Dht1 = DEVICE_DT_GET(DT_NODELABEL(dht1));
+static const struct gpio_dt_spec Dio0 =
+    GPIO_DT_SPEC_GET(DT_NODELABEL(dht0), dio_gpios);
+static const struct gpio_dt_spec Dio1 =
+    GPIO_DT_SPEC_GET(DT_NODELABEL(dht1), dio_gpios);
+
+static struct test_sensor Sensor;
+static struct k_thread SensorThread;
+static K_THREAD_STACK_DEFINE(SensorStack, TEST_SENSOR_STACK_SIZE);
+
+/**
+ * @brief Drive line to physical level and hold it for nominal usecs scaled by
+ * sensor clock. Edge callback of the driver runs within gpio_emul call, so
+ * edges are stamped by simulated time of the level change.
+ */
+static void test_sensor_hold(const struct test_sensor *sensor, int level,
+                             uint32_t us) {
+    gpio_emul_input_set(sensor->dio->port, sensor->dio->pin, level);
+    k_busy_wait(us * sensor->clock_pct / 100);
+}
+
+/**
+ * @brief Emulated sensor, answers the start signal with response, 40 bits of
+ * frame and end of frame, the way datasheet draws it.
+ */
+static void test_sensor_proc(void *arg1, void *arg2, void *arg3) {
+    const struct test_sensor *sensor = arg1;
+    gpio_flags_t flags = 0;
+    ARG_UNUSED(arg2);
+    ARG_UNUSED(arg3);
+
+    /* start signal ends when the driver turns line to input, reading thread
+     * has higher priority, so its edge interrupt is already enabled then */
+    do {
+        k_sleep(K_USEC(10));
+        gpio_emul_flags_get(sensor->dio->port, sensor->dio->pin, &flags);
+    } while (0 == (flags & GPIO_INPUT));
+
+    /* released line is pulled up */
+    gpio_emul_input_set(sensor->dio->port, sensor->dio->pin, 1);
+    if (0 == sensor->clock_pct) {
+        return;
+    }
+
+    k_busy_wait(20);
+    test_sensor_hold(sensor, 0, 80);
+    test_sensor_hold(sensor, 1, 80);
+    for (int i = 0; i < DHT2X_FRAME_BITS; i++) {
+        bool one = sensor->frame & BIT64(DHT2X_FRAME_BITS - 1 - i);
+        test_sensor_hold(sensor, 0, 50);
+        test_sensor_hold(sensor, 1, one ? 70 : 26);
+    }
+    test_sensor_hold(sensor, 0, 50);
+    gpio_emul_input_set(sensor->dio->port, sensor->dio->pin, 1);
+}
+
+static int test_read(const struct device *dev,
+                     const struct gpio_dt_spec *dio, uint64_t frame,
+                     uint32_t clock_pct) {
+    int ret = 0;
+
+    Sensor = (struct test_sensor){
+        .dio = dio,
+        .frame = frame,
+        .clock_pct = clock_pct,
+    };
+    k_thread_create(&SensorThread, SensorStack,
+                    K_THREAD_STACK_SIZEOF(SensorStack), test_sensor_proc,
+                    &Sensor, NULL, NULL, TEST_SENSOR_PRIORITY, 0, K_NO_WAIT);
+
+    ret = sensor_sample_fetch(dev);
+    k_thread_join(&SensorThread, K_FOREVER);
+    return (ret);
+}
+
+static void test_values_check(const struct device *dev, int32_t temp,
+                              int32_t rh) {
+    struct sensor_value val;
+
+    zassert_ok(sensor_channel_get(dev, SENSOR_CHAN_AMBIENT_TEMP, &val));
+    zassert_equal(val.val1 * 10 + val.val2 / 100000, temp, "%s temp %d.%06d",
+                  dev->name, val.val1, val.val2);
+    zassert_ok(sensor_channel_get(dev, SENSOR_CHAN_HUMIDITY, &val));
+    zassert_equal(val.val1 * 10 + val.val2 / 100000, rh, "%s rh %d.%06d",
+                  dev->name, val.val1, val.val2);
+}
+
+static uint32_t test_pulses(const struct dht2x_stats *stats) {
+    uint32_t pulses = 0;
+
+    for (int i = 0; i < DHT2X_PULSE_HIST_BINS; i++) {
+        pulses += stats->pulse_hist[i];
+    }
+    return (pulses);
+}
+
+static void *dht2x_emul_setup(void) {
+    zassert_true(device_is_ready(Dht0));
+    zassert_true(device_is_ready(Dht1));
+    return (NULL);
+}
+
+ZTEST(dht2x_emul, test_read_nominal) {
+    struct dht2x_stats before, after;
+
+    dht2x_stats_get(Dht0, &before);
+    zassert_ok(test_read(Dht0, &Dio0, TEST_FRAME, 100));
+    dht2x_stats_get(Dht0, &after);
+
+    test_values_check(Dht0, 215, 450);
+    zassert_equal(after.reads - before.reads, 1);
+    zassert_equal(after.timeouts, before.timeouts);
+    zassert_equal(after.recovered, before.recovered);
+    zassert_equal(after.threshold_us, 98);
+    zassert_equal(test_pulses(&after) - test_pulses(&before),
+                  DHT2X_EDGES_MAX - 1, "edges of one frame");
+}
+
+ZTEST(dht2x_emul, test_clock_deviation) {
+    static const uint32_t clocks[] = {85, 115};
+    struct dht2x_stats stats;
+
+    for (int i = 0; i < ARRAY_SIZE(clocks); i++) {
+        zassert_ok(test_read(Dht0, &Dio0, TEST_FRAME_NEG, clocks[i]),
+                   "clock %u%%", clocks[i]);
+        test_values_check(Dht0, -101, 400);
+        dht2x_stats_get(Dht0, &stats);
+        zassert_within(stats.threshold_us, 98 * clocks[i] / 100, 2);
+    }
+}
+
+ZTEST(dht2x_emul, test_timeout) {
+    struct dht2x_stats before, after;
+
+    dht2x_stats_get(Dht0, &before);
+    zassert_equal(test_read(Dht0, &Dio0, TEST_FRAME, 0), -EIO);
+    dht2x_stats_get(Dht0, &after);
+
+    zassert_equal(after.reads - before.reads, 1);
+    zassert_equal(after.timeouts - before.timeouts, 1);
+    zassert_equal(after.timeout_hist[0] - before.timeout_hist[0], 1,
+                  "no edge");
+    zassert_true(after.latency_max_us >= (18 + TEST_FRAME_TIMEOUT_MS) *
+                                             USEC_PER_MSEC,
+                 "start signal and frame timeout");
+
+    /* next read is not affected */
+    zassert_ok(test_read(Dht0, &Dio0, TEST_FRAME, 100));
+    test_values_check(Dht0, 215, 450);
+}
+
+ZTEST(dht2x_emul, test_checksum) {
+    struct dht2x_stats before, after;
+
+    zassert_ok(test_read(Dht0, &Dio0, TEST_FRAME, 100));
+    dht2x_stats_get(Dht0, &before);
+    zassert_equal(test_read(Dht0, &Dio0, TEST_FRAME_BAD, 100), -ENOTSUP);
+    dht2x_stats_get(Dht0, &after);
+
+    zassert_equal(after.checksum_errors - before.checksum_errors, 1);
+    zassert_equal(after.timeouts, before.timeouts);
+    test_values_check(Dht0, 215, 450);
+}
+
+/* Instances keep own state, reads back to back on different pins neither
+ * mix values nor statistics, edge callback is not multiplied by reads */
+ZTEST(dht2x_emul, test_instances) {
+    struct dht2x_stats before0, after0, before1, after1;
+
+    dht2x_stats_get(Dht0, &before0);
+    dht2x_stats_get(Dht1, &before1);
+    for (int i = 0; i < 3; i++) {
+        zassert_ok(test_read(Dht0, &Dio0, TEST_FRAME, 100));
+        zassert_ok(test_read(Dht1, &Dio1, TEST_FRAME_NEG, 100));
+    }
+    zassert_equal(test_read(Dht1, &Dio1, TEST_FRAME, 0), -EIO);
+    dht2x_stats_get(Dht0, &after0);
+    dht2x_stats_get(Dht1, &after1);
+
+    test_values_check(Dht0, 215, 450);
+    test_values_check(Dht1, -101, 400);
+    zassert_equal(after0.reads - before0.reads, 3);
+    zassert_equal(after1.reads - before1.reads, 4);
+    zassert_equal(after0.timeouts, before0.timeouts);
+    zassert_equal(after1.timeouts - before1.timeouts, 1);
+    zassert_equal(test_pulses(&after0) - test_pulses(&before0),
+                  3 * (DHT2X_EDGES_MAX - 1));
+    zassert_equal(test_pulses(&after1) - test_pulses(&before1),
+                  3 * (DHT2X_EDGES_MAX - 1));
+}
+
+ZTEST_SUITE(dht2x_emul, NULL, dht2x_emul_setup, NULL, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
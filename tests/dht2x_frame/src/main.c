@@ -0,0 +1,112 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "dht2x.h"
+
+#define TEST_FRAME     (0x01C200D79AULL) /* 45.0 %RH, 21.5 C */
+#define TEST_FRAME_NEG (0x0190806576ULL) /* 40.0 %RH, -10.1 C */
+
+static uint32_t Trace[DHT2X_EDGES_MAX];
+
+/**
+ * @brief Edge trace of frame, falling edge stamps since start signal release.
+ * Nominal timing scaled by clock_pct, the sensor clock deviation.
+ */
+static void test_trace_fill(uint64_t frame, uint32_t clock_pct) {
+    uint32_t t = 30;
+
+    Trace[0] = t;
+    t += 160 * clock_pct / 100;
+    for (int i = 0; i < DHT2X_FRAME_BITS; i++) {
+        bool one = frame & BIT64(DHT2X_FRAME_BITS - 1 - i);
+        Trace[1 + i] = t;
+        t += (one ? 120 : 76) * clock_pct / 100;
+    }
+    Trace[DHT2X_EDGES_MAX - 1] = t;
+}
+
+ZTEST(dht2x_frame, test_nominal) {
+    struct dht2x_frame_info info;
+    uint64_t frame = 0;
+    int16_t temp = 0, rh = 0;
+
+    test_trace_fill(TEST_FRAME, 100);
+    zassert_ok(dht2x_frame_decode(Trace, DHT2X_EDGES_MAX, &frame, &info));
+    zassert_equal(frame, TEST_FRAME, "frame %010llx", frame);
+    zassert_false(info.recovered);
+    zassert_equal(info.threshold_us, 98);
+
+    zassert_ok(dht2x_decode(frame, &temp, &rh));
+    zassert_equal(temp, 215);
+    zassert_equal(rh, 450);
+}
+
+ZTEST(dht2x_frame, test_clock_deviation) {
+    static const uint32_t clocks[] = {80, 95, 105, 120};
+    struct dht2x_frame_info info;
+    uint64_t frame = 0;
+
+    /* threshold follows preamble, nominal one would fail at 80 % */
+    for (int i = 0; i < ARRAY_SIZE(clocks); i++) {
+        test_trace_fill(TEST_FRAME, clocks[i]);
+        zassert_ok(dht2x_frame_decode(Trace, DHT2X_EDGES_MAX, &frame, &info));
+        zassert_equal(frame, TEST_FRAME, "clock %u%%", clocks[i]);
+        zassert_equal(info.threshold_us, 98 * clocks[i] / 100);
+    }
+}
+
+ZTEST(dht2x_frame, test_missed_first_edge) {
+    struct dht2x_frame_info info;
+    uint64_t frame = 0;
+
+    test_trace_fill(TEST_FRAME, 105);
+    zassert_ok(dht2x_frame_decode(&Trace[1], DHT2X_EDGES_MAX - 1, &frame,
+                                  &info));
+    zassert_equal(frame, TEST_FRAME);
+    zassert_true(info.recovered);
+    zassert_equal(info.threshold_us, 98, "nominal threshold");
+}
+
+ZTEST(dht2x_frame, test_incomplete) {
+    struct dht2x_frame_info info;
+    uint64_t frame = 0;
+
+    test_trace_fill(TEST_FRAME, 100);
+    zassert_equal(dht2x_frame_decode(Trace, 0, &frame, &info), -EAGAIN);
+    zassert_equal(dht2x_frame_decode(Trace, DHT2X_EDGES_MAX - 2, &frame,
+                                     &info),
+                  -EAGAIN);
+}
+
+ZTEST(dht2x_frame, test_negative) {
+    struct dht2x_frame_info info;
+    uint64_t frame = 0;
+    int16_t temp = 0, rh = 0;
+
+    test_trace_fill(TEST_FRAME_NEG, 100);
+    zassert_ok(dht2x_frame_decode(Trace, DHT2X_EDGES_MAX, &frame, &info));
+    zassert_ok(dht2x_decode(frame, &temp, &rh));
+    zassert_equal(temp, -101);
+    zassert_equal(rh, 400);
+}
+
+ZTEST(dht2x_frame, test_checksum) {
+    int16_t temp = 0, rh = 0;
+
+    zassert_equal(dht2x_decode(TEST_FRAME ^ BIT64(8), &temp, &rh), -ENOTSUP);
+    zassert_equal(dht2x_decode(0, &temp, &rh), -ENOTSUP, "all zero frame");
+}
+
+ZTEST_SUITE(dht2x_frame, NULL, NULL, NULL, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,273 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/net_if.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include "sntp_client.h"
+
+#define TEST_EPOCH_US       (1700000000LL * USEC_PER_SEC)
+#define TEST_NTP_OFFSET     (2208988800ULL) /* 1900 to 1970 secs */
+#define TEST_TIMEOUT_MS     (1000)
+#define TEST_SERVERS        (SNTP_CLIENT_MAX_SERVERS)
+#define TEST_SERVER_PORT    (123)
+#define TEST_SERVER_PROC_MS (3)
+#define TEST_PKT_LEN        (48)
+#define TEST_STACK_SIZE     (2048)
+#define TEST_PRIORITY       (K_PRIO_PREEMPT(5))
+
+enum test_server_mode {
+    TEST_SERVER_ANSWER,
+    TEST_SERVER_SILENT,
+    TEST_SERVER_FOREIGN,  /* originate time does not match request */
+    TEST_SERVER_UNSYNCED, /* leap indicator alarm, clock not synchronized */
+};
+
+/* Stand-in of sntp server, answers after one way network delay, its clock
+ * is off by offset_us from the true one */
+struct test_server {
+    const char *addr;
+    enum test_server_mode mode;
+    int64_t offset_us;
+    uint32_t delay_ms;
+    uint32_t requests;
+    int sock;
+};
+
+static struct test_server Servers[TEST_SERVERS] = {
+    {.addr = "127.0.0.1"},
+    {.addr = "127.0.0.2"},
+    {.addr = "127.0.0.3"},
+    {.addr = "127.0.0.4"},
+};
+
+static struct k_thread ServerThreads[TEST_SERVERS];
+static K_THREAD_STACK_ARRAY_DEFINE(ServerStacks, TEST_SERVERS,
+                                   TEST_STACK_SIZE);
+
+static int64_t test_uptime_us(void) {
+    return (k_ticks_to_us_floor64(k_uptime_ticks()));
+}
+
+static void test_ntp_ts_put(int64_t epoch_us, uint8_t *dst) {
+    uint64_t frac = ((uint64_t)(epoch_us % USEC_PER_SEC) << 32) /
+                    USEC_PER_SEC;
+
+    sys_put_be32(epoch_us / USEC_PER_SEC + TEST_NTP_OFFSET, dst);
+    sys_put_be32(frac, dst + 4);
+}
+
+static void test_server_proc(void *arg1, void *arg2, void *arg3) {
+    struct test_server *server = arg1;
+    uint8_t pkt[TEST_PKT_LEN];
+    struct sockaddr from;
+    socklen_t from_len;
+    ARG_UNUSED(arg2);
+    ARG_UNUSED(arg3);
+
+    while (1) {
+        from_len = sizeof(from);
+        ssize_t len = zsock_recvfrom(server->sock, pkt, sizeof(pkt), 0,
+                                     &from, &from_len);
+        if (TEST_PKT_LEN != len) {
+            continue;
+        }
+        server->requests++;
+        if (TEST_SERVER_SILENT == server->mode) {
+            continue;
+        }
+
+        k_sleep(K_MSEC(server->delay_ms));
+
+        /* originate time is transmit time of the request */
+        memcpy(&pkt[24], &pkt[40], 8);
+        if (TEST_SERVER_FOREIGN == server->mode) {
+            pkt[24] ^= 0xFF;
+        }
+        /* li, version 4, mode 4 - server, stratum 2 */
+        pkt[0] = ((TEST_SERVER_UNSYNCED == server->mode) ? 0xC0 : 0x00) | 0x24;
+        pkt[1] = 2;
+        test_ntp_ts_put(TEST_EPOCH_US + test_uptime_us() + server->offset_us,
+                        &pkt[32]);
+        k_sleep(K_MSEC(TEST_SERVER_PROC_MS));
+        test_ntp_ts_put(TEST_EPOCH_US + test_uptime_us() + server->offset_us,
+                        &pkt[40]);
+
+        k_sleep(K_MSEC(server->delay_ms));
+        zsock_sendto(server->sock, pkt, sizeof(pkt), 0, &from, from_len);
+    }
+}
+
+/**
+ * @brief Stand-ins listen on loopback addresses added to loopback interface,
+ * each one on sntp port, as the client always queries that one.
+ */
+static void *sntp_client_setup(void) {
+    struct net_if *iface = net_if_get_default();
+
+    zassert_not_null(iface);
+    for (int i = 0; i < TEST_SERVERS; i++) {
+        struct test_server *server = &Servers[i];
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(TEST_SERVER_PORT),
+        };
+
+        zassert_equal(zsock_inet_pton(AF_INET, server->addr, &addr.sin_addr),
+                      1);
+        zassert_not_null(net_if_ipv4_addr_add(iface, &addr.sin_addr,
+                                              NET_ADDR_MANUAL, 0),
+                         "%s", server->addr);
+
+        server->sock = zsock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        zassert_true(0 <= server->sock);
+        zassert_ok(zsock_bind(server->sock, (struct sockaddr *)&addr,
+                              sizeof(addr)));
+
+        k_thread_create(&ServerThreads[i], ServerStacks[i],
+                        K_THREAD_STACK_SIZEOF(ServerStacks[i]),
+                        test_server_proc, server, NULL, NULL, TEST_PRIORITY,
+                        0, K_NO_WAIT);
+    }
+    return (NULL);
+}
+
+static void sntp_client_before(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    for (int i = 0; i < TEST_SERVERS; i++) {
+        Servers[i].mode = TEST_SERVER_ANSWER;
+        Servers[i].offset_us = 0;
+        Servers[i].delay_ms = 10;
+        Servers[i].requests = 0;
+    }
+}
+
+/* offset of selected answer matches the server clock and round trip does
+ * not include server processing time */
+static void test_result_check(const struct sntp_client_result *res,
+                              const struct test_server *server) {
+    int64_t offset_us = res->epoch_us - res->uptime_us - TEST_EPOCH_US;
+
+    zassert_within(offset_us, server->offset_us, USEC_PER_MSEC,
+                   "offset %lld us", offset_us);
+    zassert_within(res->rtt_us, 2 * server->delay_ms * USEC_PER_MSEC,
+                   USEC_PER_MSEC, "rtt %u us", res->rtt_us);
+}
+
+ZTEST(sntp_client, test_lowest_rtt) {
+    struct sntp_client_result res = {0};
+
+    Servers[0].delay_ms = 30;
+    Servers[1].delay_ms = 5;
+    Servers[1].offset_us = 3000;
+    Servers[2].delay_ms = 60;
+    Servers[2].offset_us = -3000;
+
+    zassert_ok(sntp_client_query("127.0.0.1,127.0.0.2,127.0.0.3",
+                                 TEST_TIMEOUT_MS, &res));
+    zassert_equal(res.server, 1);
+    zassert_equal(res.answers, 3);
+    zassert_equal(res.outliers, 0);
+    test_result_check(&res, &Servers[1]);
+}
+
+/* the fastest server is 10 s off, discarded even with the lowest rtt */
+ZTEST(sntp_client, test_outlier) {
+    struct sntp_client_result res = {0};
+
+    Servers[0].delay_ms = 20;
+    Servers[1].delay_ms = 2;
+    Servers[1].offset_us = 10 * USEC_PER_SEC;
+    Servers[2].delay_ms = 10;
+    Servers[2].offset_us = 2000;
+    Servers[3].delay_ms = 40;
+    Servers[3].offset_us = -2000;
+
+    zassert_ok(sntp_client_query("127.0.0.1, 127.0.0.2, 127.0.0.3, 127.0.0.4",
+                                 TEST_TIMEOUT_MS, &res));
+    zassert_equal(res.server, 2);
+    zassert_equal(res.answers, 4);
+    zassert_equal(res.outliers, 1);
+    test_result_check(&res, &Servers[2]);
+}
+
+/* one server against the other, neither can be trusted */
+ZTEST(sntp_client, test_no_majority) {
+    struct sntp_client_result res = {0};
+
+    Servers[0].delay_ms = 5;
+    Servers[1].delay_ms = 10;
+    Servers[1].offset_us = 10 * USEC_PER_SEC;
+
+    zassert_equal(sntp_client_query("127.0.0.1,127.0.0.2", TEST_TIMEOUT_MS,
+                                    &res),
+                  -ERANGE);
+    zassert_equal(Servers[0].requests, 1);
+    zassert_equal(Servers[1].requests, 1);
+}
+
+/* unresolvable name and silent server cost at most the timeout, server index
+ * refers to the list */
+ZTEST(sntp_client, test_failover) {
+    struct sntp_client_result res = {0};
+    int64_t start_ms = k_uptime_get();
+
+    Servers[0].mode = TEST_SERVER_SILENT;
+
+    zassert_ok(sntp_client_query("ntp.invalid,127.0.0.1,127.0.0.2",
+                                 TEST_TIMEOUT_MS, &res));
+    zassert_true(k_uptime_get() - start_ms <= TEST_TIMEOUT_MS + 10);
+    zassert_equal(Servers[0].requests, 1);
+    zassert_equal(res.server, 2);
+    zassert_equal(res.answers, 1);
+    test_result_check(&res, &Servers[1]);
+}
+
+/* answers not matching the request or from unsynchronized clock are
+ * ignored */
+ZTEST(sntp_client, test_bad_answers) {
+    struct sntp_client_result res = {0};
+
+    Servers[0].mode = TEST_SERVER_FOREIGN;
+    Servers[0].delay_ms = 1;
+    Servers[1].mode = TEST_SERVER_UNSYNCED;
+    Servers[1].delay_ms = 1;
+    Servers[2].delay_ms = 30;
+
+    zassert_ok(sntp_client_query("127.0.0.1,127.0.0.2,127.0.0.3",
+                                 TEST_TIMEOUT_MS, &res));
+    zassert_equal(res.server, 2);
+    zassert_equal(res.answers, 1);
+    test_result_check(&res, &Servers[2]);
+}
+
+ZTEST(sntp_client, test_timeout) {
+    struct sntp_client_result res = {0};
+    int64_t start_ms = k_uptime_get();
+
+    Servers[0].mode = TEST_SERVER_SILENT;
+    Servers[1].mode = TEST_SERVER_SILENT;
+
+    zassert_equal(sntp_client_query("127.0.0.1,127.0.0.2", TEST_TIMEOUT_MS,
+                                    &res),
+                  -ETIMEDOUT);
+    zassert_within(k_uptime_get() - start_ms, TEST_TIMEOUT_MS, 10);
+    zassert_equal(Servers[0].requests, 1);
+    zassert_equal(Servers[1].requests, 1);
+}
+
+ZTEST_SUITE(sntp_client, NULL, sntp_client_setup, sntp_client_before, NULL,
+            NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
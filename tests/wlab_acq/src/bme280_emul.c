@@ -0,0 +1,139 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: bme280_emul.c
+ * --------------------------------------------------------------------------*/
+#define DT_DRV_COMPAT bosch_bme280
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "sensor_emul.h"
+
+#define BME280_EMUL_REG_CALIB    (0x88)
+#define BME280_EMUL_REG_H1       (0xA1)
+#define BME280_EMUL_REG_ID       (0xD0)
+#define BME280_EMUL_REG_CALIB_H  (0xE1)
+#define BME280_EMUL_REG_DATA     (0xF7)
+#define BME280_EMUL_CHIP_ID      (0x60)
+#define BME280_EMUL_REGS         (256)
+
+/* T1..T3, P1..P9 of datasheet compensation example */
+static const int32_t Bme280EmulCalib[] = {
+    27504, 26435, -1000, 36477, -10685, 3024,
+    2855,  140,   -7,    15500, -14600, 6000,
+};
+
+/* H1..H6 of a real sensor */
+#define BME280_EMUL_H1 (75)
+#define BME280_EMUL_H2 (362)
+#define BME280_EMUL_H3 (0)
+#define BME280_EMUL_H4 (324)
+#define BME280_EMUL_H5 (50)
+#define BME280_EMUL_H6 (30)
+
+struct bme280_emul_data {
+    uint8_t regs[BME280_EMUL_REGS];
+    uint8_t ptr; /* register address auto increments */
+    bool fail;
+};
+
+/**
+ * @brief Register file, write sets register address and writes following
+ * bytes, read returns registers from the address on. Status register reads
+ * zero, so measurement is always ready.
+ */
+static int bme280_emul_transfer(const struct emul *target,
+                                struct i2c_msg *msgs, int num_msgs,
+                                int addr) {
+    struct bme280_emul_data *data = target->data;
+    ARG_UNUSED(addr);
+
+    if (data->fail) {
+        return (-EIO);
+    }
+
+    for (int i = 0; i < num_msgs; i++) {
+        struct i2c_msg *msg = &msgs[i];
+
+        if (0 != (msg->flags & I2C_MSG_READ)) {
+            for (uint32_t j = 0; j < msg->len; j++) {
+                msg->buf[j] = data->regs[data->ptr++];
+            }
+        } else if (0 < msg->len) {
+            data->ptr = msg->buf[0];
+            for (uint32_t j = 1; j < msg->len; j++) {
+                data->regs[data->ptr++] = msg->buf[j];
+            }
+        }
+    }
+    return (0);
+}
+
+static const struct i2c_emul_api Bme280EmulApi = {
+    .transfer = bme280_emul_transfer,
+};
+
+static int bme280_emul_init(const struct emul *target,
+                            const struct device *parent) {
+    struct bme280_emul_data *data = target->data;
+    uint8_t *regs = data->regs;
+    ARG_UNUSED(parent);
+
+    memset(regs, 0, sizeof(data->regs));
+    regs[BME280_EMUL_REG_ID] = BME280_EMUL_CHIP_ID;
+    for (int i = 0; i < ARRAY_SIZE(Bme280EmulCalib); i++) {
+        sys_put_le16((uint16_t)Bme280EmulCalib[i],
+                     &regs[BME280_EMUL_REG_CALIB + 2 * i]);
+    }
+
+    /* H4 and H5 are 12 bit, sharing nibbles of the middle byte */
+    regs[BME280_EMUL_REG_H1] = BME280_EMUL_H1;
+    sys_put_le16(BME280_EMUL_H2, &regs[BME280_EMUL_REG_CALIB_H]);
+    regs[BME280_EMUL_REG_CALIB_H + 2] = BME280_EMUL_H3;
+    regs[BME280_EMUL_REG_CALIB_H + 3] = BME280_EMUL_H4 >> 4;
+    regs[BME280_EMUL_REG_CALIB_H + 4] =
+        ((BME280_EMUL_H5 & 0x0F) << 4) | (BME280_EMUL_H4 & 0x0F);
+    regs[BME280_EMUL_REG_CALIB_H + 5] = BME280_EMUL_H5 >> 4;
+    regs[BME280_EMUL_REG_CALIB_H + 6] = BME280_EMUL_H6;
+    return (0);
+}
+
+void bme280_emul_set(const struct emul *target, uint32_t adc_t,
+                     uint32_t adc_p, uint16_t adc_h) {
+    struct bme280_emul_data *data = target->data;
+    uint8_t *out = &data->regs[BME280_EMUL_REG_DATA];
+
+    /* press, temp msb lsb xlsb with 4 bits left aligned, hum msb lsb */
+    out[0] = adc_p >> 12;
+    out[1] = adc_p >> 4;
+    out[2] = (adc_p & 0x0F) << 4;
+    out[3] = adc_t >> 12;
+    out[4] = adc_t >> 4;
+    out[5] = (adc_t & 0x0F) << 4;
+    sys_put_be16(adc_h, &out[6]);
+}
+
+void bme280_emul_fail(const struct emul *target, bool fail) {
+    struct bme280_emul_data *data = target->data;
+
+    data->fail = fail;
+}
+
+#define BME280_EMUL_DEFINE(inst)                                               \
+    static struct bme280_emul_data Bme280EmulData##inst;                       \
+    EMUL_DT_INST_DEFINE(inst, bme280_emul_init, &Bme280EmulData##inst, NULL,   \
+                        &Bme280EmulApi, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(BME280_EMUL_DEFINE)
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
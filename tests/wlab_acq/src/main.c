@@ -0,0 +1,143 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "sensor_emul.h"
+#include "timestamp.h"
+#include "wlab_acq.h"
+#include "wlab_alarm.h"
+#include "wlab_series.h"
+
+#define TEST_TS (1700000000)
+
+/* serie index, order of app.overlay */
+#define TEST_TEMP  (0)
+#define TEST_RH    (1)
+#define TEST_PRESS (2)
+
+/* sht3xd 21.50 C, 45.00 %RH */
+#define TEST_T_RAW  (24904)
+#define TEST_RH_RAW (29491)
+
+/* bme280 25.08 C, 100.653 kPa, 51.08 %RH */
+#define TEST_ADC_T (519888)
+#define TEST_ADC_P (415148)
+#define TEST_ADC_H (30000)
+
+static const struct emul *const Sht3xd = EMUL_DT_GET(DT_NODELABEL(sht3xd));
+static const struct emul *const Bme280 = EMUL_DT_GET(DT_NODELABEL(bme280));
+
+/* Modules acquisition thread calls, samples are taken from synced clock
+ * and alarms are not evaluated */
+int64_t timestamp_get_checked(bool *synced) {
+    *synced = true;
+    return (TEST_TS);
+}
+
+void wlab_alarm_check(const struct wlab_acq_sample *sample, int64_t read_us) {
+    ARG_UNUSED(sample);
+    ARG_UNUSED(read_us);
+}
+
+/**
+ * @brief Get sample taken after emulators were set, test thread is
+ * cooperative, so queued samples were all read before.
+ */
+static void test_sample_next(struct wlab_acq_sample *sample) {
+    while (0 == wlab_acq_get(sample, K_NO_WAIT)) {
+    }
+    zassert_ok(wlab_acq_get(sample,
+                            K_SECONDS(2 * CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC)));
+}
+
+static void *wlab_acq_setup(void) {
+    wlab_acq_start();
+    return (NULL);
+}
+
+static void wlab_acq_before(void *fixture) {
+    ARG_UNUSED(fixture);
+    sht3xd_emul_fail(Sht3xd, false);
+    bme280_emul_fail(Bme280, false);
+    sht3xd_emul_set(Sht3xd, TEST_T_RAW, TEST_RH_RAW);
+    bme280_emul_set(Bme280, TEST_ADC_T, TEST_ADC_P, TEST_ADC_H);
+}
+
+ZTEST(wlab_acq, test_series) {
+    zassert_equal(WLAB_SERIES_CNT, 3);
+    zassert_equal(WlabSeries[TEST_TEMP].sensor,
+                  DEVICE_DT_GET(DT_NODELABEL(sht3xd)));
+    zassert_equal(WlabSeries[TEST_RH].sensor,
+                  DEVICE_DT_GET(DT_NODELABEL(sht3xd)));
+    zassert_equal(WlabSeries[TEST_PRESS].sensor,
+                  DEVICE_DT_GET(DT_NODELABEL(bme280)));
+    zassert_equal(WlabSeries[TEST_TEMP].channel, SENSOR_CHAN_AMBIENT_TEMP);
+    zassert_equal(WlabSeries[TEST_RH].channel, SENSOR_CHAN_HUMIDITY);
+    zassert_equal(WlabSeries[TEST_PRESS].channel, SENSOR_CHAN_PRESS);
+}
+
+ZTEST(wlab_acq, test_read) {
+    struct wlab_acq_sample sample;
+
+    test_sample_next(&sample);
+    zassert_equal(sample.ts, TEST_TS);
+    zassert_true(sample.synced);
+    zassert_equal(sample.valid, BIT_MASK(WLAB_SERIES_CNT));
+    zassert_equal(sample.val[TEST_TEMP], 215);
+    zassert_equal(sample.val[TEST_RH], 450);
+    zassert_equal(sample.val[TEST_PRESS], 10065, "0.01 kPa");
+}
+
+/* sht3xd reports negative temperature with negative val1 and positive
+ * val2, -10.099 C is -11 + 0.901 */
+ZTEST(wlab_acq, test_negative) {
+    struct wlab_acq_sample sample;
+
+    sht3xd_emul_set(Sht3xd, 13070, TEST_RH_RAW);
+    test_sample_next(&sample);
+    zassert_equal(sample.val[TEST_TEMP], -101);
+}
+
+/* temperature and humidity come from one sht3xd measurement */
+ZTEST(wlab_acq, test_fetch_once) {
+    struct wlab_acq_sample sample;
+
+    test_sample_next(&sample);
+    uint32_t fetches = sht3xd_emul_fetches(Sht3xd);
+    zassert_ok(wlab_acq_get(&sample,
+                            K_SECONDS(2 * CONFIG_WLAB_SAMPLE_PERIOD_MAX_SEC)));
+    zassert_equal(sht3xd_emul_fetches(Sht3xd) - fetches, 1);
+}
+
+/* failed sensor skips only its own series */
+ZTEST(wlab_acq, test_sensor_failure) {
+    struct wlab_acq_sample sample;
+
+    sht3xd_emul_fail(Sht3xd, true);
+    test_sample_next(&sample);
+    zassert_equal(sample.valid, BIT(TEST_PRESS));
+    zassert_equal(sample.val[TEST_TEMP], 0);
+    zassert_equal(sample.val[TEST_PRESS], 10065);
+
+    sht3xd_emul_fail(Sht3xd, false);
+    bme280_emul_fail(Bme280, true);
+    test_sample_next(&sample);
+    zassert_equal(sample.valid, BIT(TEST_TEMP) | BIT(TEST_RH));
+    zassert_equal(sample.val[TEST_TEMP], 215);
+    zassert_equal(sample.val[TEST_RH], 450);
+}
+
+ZTEST_SUITE(wlab_acq, NULL, wlab_acq_setup, wlab_acq_before, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
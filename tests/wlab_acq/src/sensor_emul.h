@@ -0,0 +1,64 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sensor_emul.h
+ * --------------------------------------------------------------------------*/
+#ifndef SENSOR_EMUL_H_
+#define SENSOR_EMUL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/drivers/emul.h>
+
+/**
+ * @brief Set raw words returned by emulated sht3xd on measurement fetch,
+ * temperature -45 + 175 * t_raw / 65535 C, humidity 100 * rh_raw / 65535 %.
+ *
+ * @param target Emulator of sht3xd node
+ * @param t_raw Raw temperature
+ * @param rh_raw Raw humidity
+ */
+void sht3xd_emul_set(const struct emul *target, uint16_t t_raw,
+                     uint16_t rh_raw);
+
+/**
+ * @brief Fail every following i2c transfer with -EIO, until cleared.
+ *
+ * @param target Emulator of sht3xd node
+ * @param fail true - fail transfers
+ */
+void sht3xd_emul_fail(const struct emul *target, bool fail);
+
+/**
+ * @brief Get number of measurements fetched since boot.
+ *
+ * @param target Emulator of sht3xd node
+ * @return uint32_t Fetched measurements
+ */
+uint32_t sht3xd_emul_fetches(const struct emul *target);
+
+/**
+ * @brief Set raw adc values of emulated bme280, compensated by datasheet
+ * example calibration, adc_t 519888 and adc_p 415148 give 25.08 C and
+ * 100653 Pa.
+ *
+ * @param target Emulator of bme280 node
+ * @param adc_t Raw temperature, 20 bit
+ * @param adc_p Raw pressure, 20 bit
+ * @param adc_h Raw humidity, 16 bit
+ */
+void bme280_emul_set(const struct emul *target, uint32_t adc_t,
+                     uint32_t adc_p, uint16_t adc_h);
+
+/**
+ * @brief Fail every following i2c transfer with -EIO, until cleared.
+ *
+ * @param target Emulator of bme280 node
+ * @param fail true - fail transfers
+ */
+void bme280_emul_fail(const struct emul *target, bool fail);
+
+#endif /* SENSOR_EMUL_H_ */
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
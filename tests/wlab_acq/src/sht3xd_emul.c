@@ -0,0 +1,122 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: sht3xd_emul.c
+ * --------------------------------------------------------------------------*/
+#define DT_DRV_COMPAT sensirion_sht3xd
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "sensor_emul.h"
+
+#define SHT3XD_EMUL_CRC_POLY (0x31)
+#define SHT3XD_EMUL_CRC_INIT (0xFF)
+#define SHT3XD_EMUL_MEAS_LEN (6)
+
+struct sht3xd_emul_data {
+    uint16_t t_raw;
+    uint16_t rh_raw;
+    uint16_t cmd; /* last command written */
+    uint32_t fetches;
+    bool fail;
+};
+
+static uint8_t sht3xd_emul_crc(const uint8_t *buf) {
+    uint8_t crc = SHT3XD_EMUL_CRC_INIT;
+
+    for (int i = 0; i < 2; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ SHT3XD_EMUL_CRC_POLY)
+                               : (uint8_t)(crc << 1);
+        }
+    }
+    return (crc);
+}
+
+static void sht3xd_emul_word(uint8_t *dst, uint16_t val) {
+    sys_put_be16(val, dst);
+    dst[2] = sht3xd_emul_crc(dst);
+}
+
+/**
+ * @brief Writes are 16 bit commands, every read returns the measurement,
+ * both words followed by crc, whatever measurement mode driver uses.
+ */
+static int sht3xd_emul_transfer(const struct emul *target,
+                                struct i2c_msg *msgs, int num_msgs,
+                                int addr) {
+    struct sht3xd_emul_data *data = target->data;
+    ARG_UNUSED(addr);
+
+    if (data->fail) {
+        return (-EIO);
+    }
+
+    for (int i = 0; i < num_msgs; i++) {
+        struct i2c_msg *msg = &msgs[i];
+
+        if (0 == (msg->flags & I2C_MSG_READ)) {
+            if (2 <= msg->len) {
+                data->cmd = sys_get_be16(msg->buf);
+            }
+            continue;
+        }
+        if (SHT3XD_EMUL_MEAS_LEN > msg->len) {
+            return (-EIO);
+        }
+        sht3xd_emul_word(&msg->buf[0], data->t_raw);
+        sht3xd_emul_word(&msg->buf[3], data->rh_raw);
+        data->fetches++;
+    }
+    return (0);
+}
+
+static const struct i2c_emul_api Sht3xdEmulApi = {
+    .transfer = sht3xd_emul_transfer,
+};
+
+static int sht3xd_emul_init(const struct emul *target,
+                            const struct device *parent) {
+    ARG_UNUSED(target);
+    ARG_UNUSED(parent);
+    return (0);
+}
+
+void sht3xd_emul_set(const struct emul *target, uint16_t t_raw,
+                     uint16_t rh_raw) {
+    struct sht3xd_emul_data *data = target->data;
+
+    data->t_raw = t_raw;
+    data->rh_raw = rh_raw;
+}
+
+void sht3xd_emul_fail(const struct emul *target, bool fail) {
+    struct sht3xd_emul_data *data = target->data;
+
+    data->fail = fail;
+}
+
+uint32_t sht3xd_emul_fetches(const struct emul *target) {
+    struct sht3xd_emul_data *data = target->data;
+
+    return (data->fetches);
+}
+
+#define SHT3XD_EMUL_DEFINE(inst)                                               \
+    static struct sht3xd_emul_data Sht3xdEmulData##inst;                       \
+    EMUL_DT_INST_DEFINE(inst, sht3xd_emul_init, &Sht3xdEmulData##inst, NULL,   \
+                        &Sht3xdEmulApi, NULL);
+
+DT_INST_FOREACH_STATUS_OKAY(SHT3XD_EMUL_DEFINE)
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
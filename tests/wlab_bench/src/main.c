@@ -0,0 +1,68 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_bench.h"
+
+/**
+ * Runs the same benchmarks as wlabbench shell command. On native_sim cycles
+ * follow simulated clock, which does not advance while code runs, and
+ * threads run on host stacks, so there the suite only guards that hot path
+ * keeps working on synthetic data. Cycles and stack are meaningful with
+ * twister --device-testing on esp32.
+ */
+ZTEST(wlab_bench, test_hot_path) {
+    struct wlab_bench_result res = {0};
+    uint32_t idx = 0;
+    int ret = 0;
+
+    TC_PRINT("%-14s %10s %10s %8s %8s\n", "bench", "cycles", "nsecs",
+             "bytes", "stack");
+    for (idx = 0;; idx++) {
+        ret = wlab_bench_run(idx, &res);
+        if (-ENOENT == ret) {
+            break;
+        }
+        zassert_ok(ret, "%s failed %d", res.name, ret);
+        TC_PRINT("%-14s %10u %10u %8u %8u\n", res.name, res.cycles,
+                 (uint32_t)k_cyc_to_ns_floor64(res.cycles), res.bytes,
+                 res.stack);
+    }
+    zassert_true(0 < idx, "no benchmark");
+}
+
+static int test_bench_find(const char *name, struct wlab_bench_result *res) {
+    for (uint32_t idx = 0;; idx++) {
+        int ret = wlab_bench_run(idx, res);
+        if ((-ENOENT == ret) || (0 == strcmp(res->name, name))) {
+            return (ret);
+        }
+    }
+}
+
+/* Payload published before wlab_codec was rendered by printf templates into
+ * staging buffer and copied into transmit buffer, the codec renders the same
+ * payload straight into transmit buffer */
+ZTEST(wlab_bench, test_json_old_vs_new) {
+    struct wlab_bench_result old = {0};
+    struct wlab_bench_result new = {0};
+
+    zassert_ok(test_bench_find("json_printf", &old));
+    zassert_ok(test_bench_find("json_encode", &new));
+    zassert_equal(old.bytes, new.bytes, "payloads differ");
+    TC_PRINT("json printf %u cycles, codec %u cycles\n", old.cycles,
+             new.cycles);
+}
+
+ZTEST_SUITE(wlab_bench, NULL, NULL, NULL, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_buffer.h"
+
+#define TEST_PERIOD (600)
+#define TEST_TS     (1699999800) /* aligned to TEST_PERIOD */
+
+static struct wlab_buffer Buffer;
+
+static void wlab_buffer_before(void *fixture) {
+    ARG_UNUSED(fixture);
+    wlab_buffer_init(&Buffer);
+}
+
+ZTEST(wlab_buffer, test_empty) {
+    struct wlab_record_serie serie;
+
+    memset(&serie, 0xAA, sizeof(serie));
+    wlab_buffer_fill(&serie, &Buffer);
+    zassert_equal(serie.cnt, 0);
+    zassert_equal(serie.avg, 0);
+    zassert_equal(serie.min_ts, 0);
+}
+
+ZTEST(wlab_buffer, test_aggregate) {
+    static const int32_t vals[] = {215, 209, 220, 217, -3};
+    struct wlab_record_serie serie;
+    uint32_t ts = TEST_TS + 7;
+
+    for (int i = 0; i < ARRAY_SIZE(vals); i++) {
+        wlab_buffer_commit(&Buffer, vals[i], ts, TEST_PERIOD);
+        ts += 100;
+    }
+    wlab_buffer_fill(&serie, &Buffer);
+
+    zassert_equal(Buffer.sample_ts, TEST_TS, "window start");
+    zassert_equal(serie.act, 215, "act is the first sample");
+    zassert_equal(serie.avg, (215 + 209 + 220 + 217 - 3) / 5);
+    zassert_equal(serie.min, -3);
+    zassert_equal(serie.max, 220);
+    zassert_equal(serie.cnt, ARRAY_SIZE(vals));
+
+    /* extreme timestamps are minute aligned */
+    zassert_equal(serie.min_ts, TEST_TS + 360);
+    zassert_equal(serie.max_ts, TEST_TS + 180);
+}
+
+ZTEST(wlab_buffer, test_first_extreme_kept) {
+    struct wlab_record_serie serie;
+
+    wlab_buffer_commit(&Buffer, 215, TEST_TS + 60, TEST_PERIOD);
+    wlab_buffer_commit(&Buffer, 215, TEST_TS + 300, TEST_PERIOD);
+    wlab_buffer_fill(&serie, &Buffer);
+
+    zassert_equal(serie.min_ts, TEST_TS + 60);
+    zassert_equal(serie.max_ts, TEST_TS + 60);
+}
+
+ZTEST(wlab_buffer, test_reinit) {
+    struct wlab_record_serie serie;
+
+    wlab_buffer_commit(&Buffer, 215, TEST_TS, TEST_PERIOD);
+    wlab_buffer_init(&Buffer);
+    wlab_buffer_commit(&Buffer, 100, TEST_TS + TEST_PERIOD + 4, TEST_PERIOD);
+    wlab_buffer_fill(&serie, &Buffer);
+
+    zassert_equal(Buffer.sample_ts, TEST_TS + TEST_PERIOD);
+    zassert_equal(serie.act, 100);
+    zassert_equal(serie.max, 100);
+    zassert_equal(serie.cnt, 1);
+}
+
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+ZTEST(wlab_buffer, test_extended) {
+    static const int32_t vals[] = {20, 40, 40, 40, 50, 50, 70, 90};
+    struct wlab_record_serie serie;
+
+    for (int i = 0; i < ARRAY_SIZE(vals); i++) {
+        wlab_buffer_commit(&Buffer, vals[i], TEST_TS + i, TEST_PERIOD);
+    }
+    wlab_buffer_fill(&serie, &Buffer);
+
+    zassert_equal(serie.std, 21);
+    zassert_within(serie.quantile, 45, 5, "median %d", serie.quantile);
+}
+#endif
+
+ZTEST_SUITE(wlab_buffer, NULL, NULL, wlab_buffer_before, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
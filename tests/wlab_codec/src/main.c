@@ -0,0 +1,260 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_codec.h"
+#include "wlab_series.h"
+
+#define TEST_UID ("0A1B2C3D4E5F")
+#define TEST_TS  (1700000000)
+
+BUILD_ASSERT(2 == WLAB_SERIES_CNT, "Test overlay defines 2 series");
+
+/* Record of example in wlab_codec.h */
+static void test_record_fill(struct wlab_record *record, uint32_t ts) {
+    memset(record, 0, sizeof(struct wlab_record));
+    record->ts = ts;
+    record->serie[0] = (struct wlab_record_serie){
+        .avg = 215,
+        .act = 217,
+        .min = 209,
+        .max = 220,
+        .min_ts = ts + 60,
+        .max_ts = ts + 420,
+        .cnt = 150,
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+        .std = 12,
+        .quantile = 214,
+#endif
+    };
+    record->serie[1] = (struct wlab_record_serie){
+        .avg = 450,
+        .act = 448,
+        .min = 431,
+        .max = 462,
+        .min_ts = ts + 540,
+        .max_ts = ts,
+        .cnt = 150,
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+        .std = 8,
+        .quantile = 450,
+#endif
+    };
+}
+
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+#define TEST_JSON_TEMP_EXT ",\"f_std\":1.2,\"f_p50\":21.4"
+#define TEST_JSON_RH_EXT   ",\"f_std\":0.8,\"f_p50\":45.0"
+#define TEST_BIN_VERSION   (2)
+#define TEST_BIN_SERIE_LEN (18)
+#else
+#define TEST_JSON_TEMP_EXT ""
+#define TEST_JSON_RH_EXT   ""
+#define TEST_BIN_VERSION   (1)
+#define TEST_BIN_SERIE_LEN (14)
+#endif
+
+static const char *const TestJsonRecord =
+    "{\"UID\":\"0A1B2C3D4E5F\",\"TS\":1700000000,\"FLAGS\":0,\"SERIE\":{"
+    "\"Temperature\":{\"f_avg\":21.5,\"f_act\":21.7,\"f_min\":20.9,"
+    "\"f_max\":22.0,\"i_min_ts\":1700000060,\"i_max_ts\":1700000420,"
+    "\"i_cnt\":150" TEST_JSON_TEMP_EXT "},"
+    "\"Humidity\":{\"f_avg\":45.0,\"f_act\":44.8,\"f_min\":43.1,"
+    "\"f_max\":46.2,\"i_min_ts\":1700000540,\"i_max_ts\":1700000000,"
+    "\"i_cnt\":150" TEST_JSON_RH_EXT "}}}";
+
+ZTEST(wlab_codec, test_itostrf) {
+    static const struct {
+        int32_t val;
+        uint32_t scale;
+        const char *str;
+    } cases[] = {
+        {0, 1, "0"},
+        {0, 10, "0.0"},
+        {215, 10, "21.5"},
+        {-1234, 10, "-123.4"},
+        {-5, 10, "-0.5"},
+        {5, 100, "0.05"},
+        {101325, 100, "1013.25"},
+        {INT32_MAX, 1000, "2147483.647"},
+        {INT32_MIN, 1, "-2147483648"},
+    };
+    char num[WLAB_CODEC_NUM_MAX_LEN];
+
+    for (int i = 0; i < ARRAY_SIZE(cases); i++) {
+        int len = wlab_itostrf(num, cases[i].val, cases[i].scale);
+        zassert_str_equal(num, cases[i].str, "%d/%u", cases[i].val,
+                          cases[i].scale);
+        zassert_equal(len, strlen(cases[i].str));
+    }
+}
+
+ZTEST(wlab_codec, test_json_record) {
+    static char expected[CONFIG_MQTT_WORKER_MAX_PUBLISH_LEN];
+    static uint8_t dst[CONFIG_MQTT_WORKER_MAX_PUBLISH_LEN];
+    struct wlab_record record;
+    uint32_t cnt = 1;
+
+    test_record_fill(&record, TEST_TS);
+    snprintf(expected, sizeof(expected),
+             (1 < CONFIG_WLAB_PUB_BATCH_SIZE) ? "[%s]" : "%s", TestJsonRecord);
+
+    int len = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, &record, &cnt, NULL,
+                                sizeof(dst));
+    zassert_equal(len, strlen(expected), "length pass %d", len);
+    zassert_equal(cnt, 1);
+
+    /* exact length buffer, +1 for \0 */
+    memset(dst, 0xAA, sizeof(dst));
+    int ret = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, &record, &cnt, dst,
+                                len + 1);
+    zassert_equal(ret, len, "write pass %d", ret);
+    zassert_str_equal((char *)dst, expected);
+    zassert_equal(dst[len + 1], 0xAA, "written past payload");
+}
+
+ZTEST(wlab_codec, test_json_batch) {
+    static uint8_t dst[CONFIG_MQTT_WORKER_MAX_PUBLISH_LEN];
+    struct wlab_record records[3];
+    uint32_t cnt = ARRAY_SIZE(records);
+
+    for (int i = 0; i < ARRAY_SIZE(records); i++) {
+        test_record_fill(&records[i], TEST_TS + 600 * i);
+    }
+
+    int one = strlen(TestJsonRecord);
+    int len = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, records, &cnt, NULL,
+                                sizeof(dst));
+
+    if (1 == CONFIG_WLAB_PUB_BATCH_SIZE) {
+        /* single object, the rest waits for next message */
+        zassert_equal(cnt, 1);
+        zassert_equal(len, one);
+        return;
+    }
+
+    zassert_equal(cnt, ARRAY_SIZE(records));
+    zassert_equal(len, 2 + 3 * one + 2, "len %d", len);
+
+    /* room for 2 records only, length pass and write pass agree */
+    uint32_t trimmed = ARRAY_SIZE(records);
+    size_t size = 2 + 2 * one + 1 + 1;
+    len = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, records, &trimmed, NULL,
+                            size);
+    zassert_equal(trimmed, 2);
+    int ret = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, records, &trimmed,
+                                dst, len + 1);
+    zassert_equal(ret, len);
+    zassert_equal(trimmed, 2);
+    zassert_equal(dst[0], '[');
+    zassert_equal(dst[len - 1], ']');
+    zassert_equal(dst[len], '\0');
+}
+
+ZTEST(wlab_codec, test_json_no_room) {
+    static uint8_t dst[64];
+    struct wlab_record record;
+    uint32_t cnt = 1;
+
+    test_record_fill(&record, TEST_TS);
+    int ret = wlab_codec_encode(WLAB_CODEC_JSON, TEST_UID, &record, &cnt, dst,
+                                sizeof(dst));
+    zassert_equal(ret, -ENOMEM);
+}
+
+ZTEST(wlab_codec, test_bin_example) {
+    static const uint8_t expected[] = {
+        TEST_BIN_VERSION, 0x01, 0x0A, 0x1B, 0x2C, 0x3D, 0x4E, 0x5F,
+        0x02, 0x01, 0x02,
+        /* record */
+        0x00, 0xF1, 0x53, 0x65, 0x00,
+        /* temperature */
+        0xD7, 0x00, 0xD9, 0x00, 0xD1, 0x00, 0xDC, 0x00, 0x3C, 0x00, 0xA4, 0x01,
+        0x96, 0x00,
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+        0x0C, 0x00, 0xD6, 0x00,
+#endif
+        /* humidity */
+        0xC2, 0x01, 0xC0, 0x01, 0xAF, 0x01, 0xCE, 0x01, 0x1C, 0x02, 0x00, 0x00,
+        0x96, 0x00,
+#if defined(CONFIG_WLAB_STATS_EXTENDED)
+        0x08, 0x00, 0xC2, 0x01,
+#endif
+    };
+    uint8_t dst[sizeof(expected) + 4];
+    struct wlab_record record;
+    uint32_t cnt = 1;
+
+    test_record_fill(&record, TEST_TS);
+    int len = wlab_codec_encode(WLAB_CODEC_BIN, TEST_UID, &record, &cnt, NULL,
+                                sizeof(dst));
+    zassert_equal(len, sizeof(expected), "length pass %d", len);
+
+    int ret = wlab_codec_encode(WLAB_CODEC_BIN, TEST_UID, &record, &cnt, dst,
+                                sizeof(dst));
+    zassert_equal(ret, len);
+    zassert_mem_equal(dst, expected, sizeof(expected));
+}
+
+ZTEST(wlab_codec, test_bin_fits) {
+    const size_t rec_len = 5 + 2 * TEST_BIN_SERIE_LEN;
+    uint8_t dst[11 + 2 * (5 + 2 * TEST_BIN_SERIE_LEN) + 8];
+    struct wlab_record records[3];
+    uint32_t cnt = ARRAY_SIZE(records);
+
+    for (int i = 0; i < ARRAY_SIZE(records); i++) {
+        test_record_fill(&records[i], TEST_TS + 600 * i);
+    }
+    records[1].serie[0].min_ts = 0;
+
+    int ret = wlab_codec_encode(WLAB_CODEC_BIN, TEST_UID, records, &cnt, dst,
+                                sizeof(dst));
+    zassert_equal(cnt, 2);
+    zassert_equal(ret, 11 + 2 * rec_len);
+    zassert_equal(dst[1], 2);
+    /* min_ts of second record is none */
+    zassert_equal(dst[11 + rec_len + 5 + 8], 0xFF);
+    zassert_equal(dst[11 + rec_len + 5 + 9], 0xFF);
+}
+
+ZTEST(wlab_codec, test_bin_ts_none) {
+    uint8_t dst[64];
+    struct wlab_record record;
+    uint32_t cnt = 1;
+
+    test_record_fill(&record, TEST_TS);
+    record.flags = WLAB_RECORD_EMPTY;
+    memset(record.serie, 0, sizeof(record.serie));
+
+    int ret = wlab_codec_encode(WLAB_CODEC_BIN, TEST_UID, &record, &cnt, dst,
+                                sizeof(dst));
+    zassert_true(0 < ret);
+    zassert_equal(dst[11 + 4], WLAB_RECORD_EMPTY);
+    /* min_ts and max_ts of empty serie are none */
+    zassert_equal(sys_get_le16(&dst[11 + 5 + 8]), 0xFFFF);
+    zassert_equal(sys_get_le16(&dst[11 + 5 + 10]), 0xFFFF);
+}
+
+ZTEST(wlab_codec, test_auth_series) {
+    char dst[64];
+
+    int len = wlab_codec_auth_series(dst, sizeof(dst));
+    zassert_str_equal(dst, "{\"Temperature\":1,\"Humidity\":2}");
+    zassert_equal(len, strlen(dst));
+    zassert_equal(wlab_codec_auth_series(dst, 16), -ENOMEM);
+}
+
+ZTEST_SUITE(wlab_codec, NULL, NULL, NULL, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
@@ -0,0 +1,88 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_filter.h"
+
+/* temperature serie of esp32 overlay, 0.1 C unit */
+#define TEST_WINDOW    (7)
+#define TEST_NSIGMA    (30)
+#define TEST_TOLERANCE (8)
+
+static struct wlab_filter Filter;
+
+static bool test_check(int32_t val) {
+    return wlab_filter_check(&Filter, val, TEST_NSIGMA, TEST_TOLERANCE);
+}
+
+static void wlab_filter_before(void *fixture) {
+    ARG_UNUSED(fixture);
+    wlab_filter_init(&Filter, TEST_WINDOW);
+}
+
+ZTEST(wlab_filter, test_first_readings) {
+    /* nothing to compare with, anything goes */
+    zassert_true(test_check(215));
+    zassert_true(test_check(-400));
+    zassert_equal(Filter.accepted, 2);
+}
+
+ZTEST(wlab_filter, test_spike_on_flat) {
+    for (int i = 0; i < TEST_WINDOW - 1; i++) {
+        zassert_true(test_check(215));
+    }
+
+    /* zero MAD, only min tolerance is left */
+    zassert_false(test_check(300), "spike accepted");
+    zassert_true(test_check(215 + TEST_TOLERANCE));
+    zassert_true(test_check(215 - TEST_TOLERANCE));
+    zassert_equal(Filter.rejected, 1);
+    zassert_equal(Filter.accepted, TEST_WINDOW + 1);
+}
+
+ZTEST(wlab_filter, test_noisy_signal) {
+    static const int32_t noise[] = {0, 20, -20, 10, -10, 30, -30};
+
+    for (int i = 0; i < ARRAY_SIZE(noise); i++) {
+        zassert_true(test_check(215 + noise[i]));
+    }
+
+    /* median 22.5 C, MAD 2.0 C gives sigma 2.97 C, tolerance 3 sigma 8.8 C */
+    zassert_false(test_check(215 + 150));
+    zassert_true(test_check(215 + 60));
+}
+
+ZTEST(wlab_filter, test_step_followed) {
+    for (int i = 0; i < TEST_WINDOW; i++) {
+        test_check(215);
+    }
+
+    /* sustained step is rejected until it holds majority of window */
+    int accepted_at = -1;
+    for (int i = 0; i < TEST_WINDOW; i++) {
+        if (test_check(315) && (0 > accepted_at)) {
+            accepted_at = i;
+        }
+    }
+    zassert_equal(accepted_at, TEST_WINDOW / 2, "accepted at %d",
+                  accepted_at);
+}
+
+ZTEST(wlab_filter, test_window_limit) {
+    wlab_filter_init(&Filter, 1000);
+    zassert_equal(Filter.size, CONFIG_WLAB_FILTER_WINDOW_MAX);
+    wlab_filter_init(&Filter, 0);
+    zassert_equal(Filter.size, 1);
+}
+
+ZTEST_SUITE(wlab_filter, NULL, NULL, wlab_filter_before, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
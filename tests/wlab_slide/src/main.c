@@ -0,0 +1,135 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <errno.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_slide.h"
+
+#define TEST_TS      (1700000000)
+#define TEST_SAMPLES (2000)
+
+static struct wlab_slide Slide;
+
+/* Window of the last TEST_SAMPLES samples, checked against brute force */
+static int32_t Vals[TEST_SAMPLES];
+static uint32_t Ts[TEST_SAMPLES];
+
+static int32_t test_val(uint32_t i) {
+    /* saw tooth with noise, deque drops many samples now and then */
+    return (215 + (int32_t)((i * 7919) % 23) - (int32_t)(i % 150) / 2);
+}
+
+/**
+ * @brief Rolling values of samples [0, cnt) not expired at ts, the latest
+ * of equal extremes wins as in deque.
+ */
+static void test_expected(uint32_t cnt, uint32_t ts,
+                          struct wlab_slide_value *value) {
+    int64_t sum = 0;
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (Ts[i] + CONFIG_WLAB_SLIDE_WINDOW_SECS <= ts) {
+            continue;
+        }
+        if (cnt - i > WLAB_SLIDE_LEN) {
+            continue;
+        }
+        if ((0 == n) || (Vals[i] <= value->min)) {
+            value->min = Vals[i];
+            value->min_ts = Ts[i];
+        }
+        if ((0 == n) || (Vals[i] >= value->max)) {
+            value->max = Vals[i];
+            value->max_ts = Ts[i];
+        }
+        if (0 == n) {
+            value->first_ts = Ts[i];
+        }
+        sum += Vals[i];
+        n++;
+    }
+    value->cnt = n;
+    value->avg = (0 < n) ? (sum / n) : 0;
+}
+
+static void wlab_slide_before(void *fixture) {
+    ARG_UNUSED(fixture);
+    wlab_slide_init(&Slide);
+}
+
+ZTEST(wlab_slide, test_empty) {
+    struct wlab_slide_value value;
+
+    zassert_equal(wlab_slide_get(&Slide, TEST_TS, &value), -ENODATA);
+}
+
+ZTEST(wlab_slide, test_brute_force) {
+    struct wlab_slide_value value;
+    struct wlab_slide_value expected;
+    uint32_t ts = TEST_TS;
+
+    for (uint32_t i = 0; i < TEST_SAMPLES; i++) {
+        /* irregular adaptive period, 4 to 32 s */
+        ts += 4 << (i / 100 % 4);
+        Vals[i] = test_val(i);
+        Ts[i] = ts;
+        wlab_slide_add(&Slide, Vals[i], ts);
+
+        zassert_ok(wlab_slide_get(&Slide, ts, &value));
+        test_expected(i + 1, ts, &expected);
+        zassert_equal(value.cnt, expected.cnt, "%u: cnt %u", i, value.cnt);
+        zassert_equal(value.avg, expected.avg, "%u: avg %d", i, value.avg);
+        zassert_equal(value.min, expected.min, "%u: min %d", i, value.min);
+        zassert_equal(value.max, expected.max, "%u: max %d", i, value.max);
+        zassert_equal(value.min_ts, expected.min_ts, "%u: min_ts", i);
+        zassert_equal(value.max_ts, expected.max_ts, "%u: max_ts", i);
+        zassert_equal(value.first_ts, expected.first_ts, "%u: first_ts", i);
+    }
+}
+
+ZTEST(wlab_slide, test_capacity) {
+    struct wlab_slide_value value;
+    uint32_t ts = TEST_TS;
+
+    /* sample every second, window would hold more than capacity */
+    for (uint32_t i = 0; i < 2 * WLAB_SLIDE_LEN; i++) {
+        wlab_slide_add(&Slide, i, ts++);
+    }
+
+    zassert_ok(wlab_slide_get(&Slide, ts, &value));
+    zassert_equal(value.cnt, WLAB_SLIDE_LEN);
+    zassert_equal(value.min, WLAB_SLIDE_LEN, "oldest sample not evicted");
+    zassert_equal(value.max, 2 * WLAB_SLIDE_LEN - 1);
+}
+
+ZTEST(wlab_slide, test_expiry) {
+    struct wlab_slide_value value;
+
+    wlab_slide_add(&Slide, 100, TEST_TS);
+    wlab_slide_add(&Slide, 300, TEST_TS + 10);
+
+    zassert_ok(wlab_slide_get(&Slide, TEST_TS + 599, &value));
+    zassert_equal(value.cnt, 2);
+    zassert_equal(value.avg, 200);
+
+    /* the first sample expires exactly CONFIG_WLAB_SLIDE_WINDOW_SECS later */
+    zassert_ok(wlab_slide_get(&Slide, TEST_TS + CONFIG_WLAB_SLIDE_WINDOW_SECS,
+                              &value));
+    zassert_equal(value.cnt, 1);
+    zassert_equal(value.min, 300);
+    zassert_equal(value.first_ts, TEST_TS + 10);
+
+    zassert_equal(wlab_slide_get(&Slide, TEST_TS + 10000, &value), -ENODATA);
+}
+
+ZTEST_SUITE(wlab_slide, NULL, NULL, wlab_slide_before, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/
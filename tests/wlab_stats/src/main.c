@@ -0,0 +1,101 @@
+/* ---------------------------------------------------------------------------
+ *  wlab_station
+ * ---------------------------------------------------------------------------
+ *  Name: main.c
+ * --------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include "wlab_stats.h"
+
+#define TEST_P2_SAMPLES (1001)
+
+/* values -500..500, each once, in scrambled order, 37 is coprime with
+ * TEST_P2_SAMPLES */
+static int32_t test_p2_sample(uint32_t i) {
+    return ((int32_t)((i * 37) % TEST_P2_SAMPLES) - 500);
+}
+
+ZTEST(wlab_stats, test_var_empty) {
+    struct wlab_stats_var var;
+
+    wlab_stats_var_init(&var);
+    zassert_equal(wlab_stats_var_stddev(&var), 0);
+    wlab_stats_var_add(&var, 215);
+    zassert_equal(wlab_stats_var_stddev(&var), 0, "single sample");
+}
+
+ZTEST(wlab_stats, test_var_stddev) {
+    /* sample stddev of 2, 4, 4, 4, 5, 5, 7, 9 is 2.138 */
+    static const int32_t vals[] = {20, 40, 40, 40, 50, 50, 70, 90};
+    struct wlab_stats_var var;
+
+    wlab_stats_var_init(&var);
+    for (int i = 0; i < ARRAY_SIZE(vals); i++) {
+        wlab_stats_var_add(&var, vals[i]);
+    }
+    zassert_equal(wlab_stats_var_stddev(&var), 21);
+}
+
+ZTEST(wlab_stats, test_var_negative) {
+    static const int32_t vals[] = {-20, -40, -40, -40, -50, -50, -70, -90};
+    struct wlab_stats_var var;
+
+    wlab_stats_var_init(&var);
+    for (int i = 0; i < ARRAY_SIZE(vals); i++) {
+        wlab_stats_var_add(&var, vals[i]);
+    }
+    zassert_equal(wlab_stats_var_stddev(&var), 21);
+}
+
+ZTEST(wlab_stats, test_var_flat) {
+    struct wlab_stats_var var;
+
+    wlab_stats_var_init(&var);
+    for (int i = 0; i < 1000; i++) {
+        wlab_stats_var_add(&var, -150);
+    }
+    zassert_equal(wlab_stats_var_stddev(&var), 0);
+}
+
+ZTEST(wlab_stats, test_p2_exact) {
+    struct wlab_stats_p2 p2;
+
+    wlab_stats_p2_init(&p2, 500);
+    zassert_equal(wlab_stats_p2_get(&p2), 0, "no sample");
+
+    /* less than 5 samples, exact quantile */
+    wlab_stats_p2_add(&p2, 5);
+    wlab_stats_p2_add(&p2, -1);
+    wlab_stats_p2_add(&p2, 3);
+    zassert_equal(wlab_stats_p2_get(&p2), 3);
+}
+
+ZTEST(wlab_stats, test_p2_median) {
+    struct wlab_stats_p2 p2;
+
+    wlab_stats_p2_init(&p2, 500);
+    for (uint32_t i = 0; i < TEST_P2_SAMPLES; i++) {
+        wlab_stats_p2_add(&p2, test_p2_sample(i));
+    }
+    zassert_within(wlab_stats_p2_get(&p2), 0, 10, "median %d",
+                   wlab_stats_p2_get(&p2));
+}
+
+ZTEST(wlab_stats, test_p2_p90) {
+    struct wlab_stats_p2 p2;
+
+    wlab_stats_p2_init(&p2, 900);
+    for (uint32_t i = 0; i < TEST_P2_SAMPLES; i++) {
+        wlab_stats_p2_add(&p2, test_p2_sample(i));
+    }
+    zassert_within(wlab_stats_p2_get(&p2), 400, 20, "p90 %d",
+                   wlab_stats_p2_get(&p2));
+}
+
+ZTEST_SUITE(wlab_stats, NULL, NULL, NULL, NULL, NULL);
+
+/* ---------------------------------------------------------------------------
+ * end of file
+ * --------------------------------------------------------------------------*/